@@ -0,0 +1,51 @@
+#ifndef HIST_H
+#define HIST_H
+
+/* Latency histogram with HDR-style log-linear buckets: exact below 2^HIST_SUB_BITS ns, then
+   2^HIST_SUB_BITS buckets per power of two, so any recorded value is within 1% of its bucket.
+   Not synchronised: give each thread its own and merge (or read) them after the join.
+   Shared by q1_pipeline (item latency) and q3_royal_banquet (wait times). */
+
+#define HIST_SUB_BITS 7
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct {
+    long long count[HIST_BUCKETS];
+    long long n, sum, max;
+} Hist;
+
+static inline int hist_index(long long v) {
+    if (v < (1 << HIST_SUB_BITS)) return v < 0 ? 0 : (int)v;
+    int shift = 63 - __builtin_clzll((unsigned long long)v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int)((v >> shift) - (1 << HIST_SUB_BITS));
+}
+
+static inline long long hist_value(int idx) {   // midpoint of the bucket
+    if (idx < (1 << HIST_SUB_BITS)) return idx;
+    int shift = (idx >> HIST_SUB_BITS) - 1;
+    long long lo = (long long)((1 << HIST_SUB_BITS) + (idx & ((1 << HIST_SUB_BITS) - 1))) << shift;
+    return lo + (1LL << shift) / 2;
+}
+
+static inline void hist_add(Hist *h, long long v) {
+    h->count[hist_index(v)]++;
+    h->n++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hist_merge(Hist *h, const Hist *o) {
+    for (int i = 0; i < HIST_BUCKETS; i++) h->count[i] += o->count[i];
+    h->n += o->n;
+    h->sum += o->sum;
+    if (o->max > h->max) h->max = o->max;
+}
+
+static inline long long hist_percentile(const Hist *h, double q) {
+    long long rank = (long long)(q * h->n), seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        if ((seen += h->count[i]) > rank) return hist_value(i) < h->max ? hist_value(i) : h->max;
+    return h->max;
+}
+
+#endif
@@ -1,173 +1,833 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <limits.h>
+#ifdef __linux__
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "hist.h"
 
 #define N 50
 #define BUF1_SIZE 10
 #define BUF2_SIZE 10
 #define NUM_PRODUCERS 2
 #define NUM_PROCESSORS 2
+#define NUM_CONSUMERS 1
+#define MAX_STAGES 8
+#define MAX_STAGE_THREADS 64
+#define BB_SPIN 64          // initial spin limit before yielding
+#define BB_SPIN_MIN 16      // bounds for the adaptive spin limit
+#define BB_SPIN_MAX 2048
+#define BB_YIELDS 4         // sched_yield() calls between spinning and parking
+#define BB_PARK_NS 20000LL  // waits shorter than this were worth spinning through
+#define BATCH 8             // items moved per buffer operation / lock acquisition
+#define BATCH_FLUSH_NS 50000LL  // longest a processed item waits in a partial batch
+#define WS_GRAB (4 * BATCH) // items a work-stealing worker takes from its input at once
 
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bb_smp = -1;     // more than one CPU online; set by the first ev_init
+
+/* Event count used to park on full/empty. Waiters register before re-checking the
+   buffer, so a notifier that sees no registered waiter can skip the wake-up. */
 typedef struct {
-    int *data;
-    int cap, head, tail, count;
+    _Atomic uint32_t seq;
+    _Atomic int waiters;
+    _Atomic int spin_limit;     // adaptive, shared by every thread waiting on this event
+    _Atomic long parks;
+#ifndef __linux__
     pthread_mutex_t m;
-    pthread_cond_t not_full, not_empty;
+    pthread_cond_t c;
+#endif
+} BBEvent;
+
+static void ev_init(BBEvent *e) {
+    atomic_init(&e->seq, 0);
+    atomic_init(&e->waiters, 0);
+    if (bb_smp < 0) bb_smp = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    atomic_init(&e->spin_limit, bb_smp ? BB_SPIN : 0);
+    atomic_init(&e->parks, 0);
+#ifndef __linux__
+    pthread_mutex_init(&e->m, NULL);
+    pthread_cond_init(&e->c, NULL);
+#endif
+}
+
+static void ev_destroy(BBEvent *e) {
+#ifndef __linux__
+    pthread_mutex_destroy(&e->m);
+    pthread_cond_destroy(&e->c);
+#else
+    (void)e;
+#endif
+}
+
+static uint32_t ev_prepare(BBEvent *e) {
+    atomic_fetch_add(&e->waiters, 1);
+    return atomic_load(&e->seq);
+}
+
+static void ev_cancel(BBEvent *e) { atomic_fetch_sub(&e->waiters, 1); }
+
+static void ev_wait(BBEvent *e, uint32_t seen) {
+    atomic_fetch_add_explicit(&e->parks, 1, memory_order_relaxed);
+#ifdef __linux__
+    syscall(SYS_futex, &e->seq, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&e->m);
+    while (atomic_load(&e->seq) == seen) pthread_cond_wait(&e->c, &e->m);
+    pthread_mutex_unlock(&e->m);
+#endif
+    atomic_fetch_sub(&e->waiters, 1);
+}
+
+// Wake up to n parked threads (n items or slots became available).
+static void ev_notify(BBEvent *e, int n) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&e->waiters, memory_order_relaxed) == 0) return;
+#ifdef __linux__
+    atomic_fetch_add(&e->seq, 1);
+    syscall(SYS_futex, &e->seq, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&e->m);
+    atomic_fetch_add(&e->seq, 1);
+    if (n > 1) pthread_cond_broadcast(&e->c);
+    else pthread_cond_signal(&e->c);
+    pthread_mutex_unlock(&e->m);
+#endif
+}
+
+/* Adaptive wait: spin with cpu_relax() up to the event's spin limit, then yield a few
+   times, then park. When a wait ends the limit is retuned from how long it took: waits
+   that ended while spinning pull the limit toward twice the spins they needed, waits
+   that ended within BB_PARK_NS of the spin phase raise it, and longer ones lower it.
+   On a single CPU the partner cannot run while we spin, so the limit stays 0. */
+
+typedef struct {
+    int n;              // failed attempts so far
+    long long t0;       // when spinning stopped, 0 while still spinning
+    int parked;
+} BBWaiter;
+
+static void wt_begin(BBWaiter *w) { w->n = 0; w->t0 = 0; w->parked = 0; }
+
+// One backoff step after a failed attempt. Returns 1 when the caller should park.
+static int wt_backoff(BBEvent *e, BBWaiter *w) {
+    int limit = atomic_load_explicit(&e->spin_limit, memory_order_relaxed);
+    if (w->n < limit && !w->parked) { w->n++; cpu_relax(); return 0; }
+    if (w->t0 == 0) w->t0 = now_ns();
+    if (w->n < limit + BB_YIELDS && !w->parked) { w->n++; sched_yield(); return 0; }
+    w->parked = 1;
+    return 1;
+}
+
+static void wt_end(BBEvent *e, BBWaiter *w) {
+    if (w->n == 0 || !bb_smp) return;
+    int limit = atomic_load_explicit(&e->spin_limit, memory_order_relaxed);
+    if (w->t0 == 0) limit += (2 * w->n - limit) / 8;
+    else if (now_ns() - w->t0 < BB_PARK_NS) limit += limit / 8 + 1;
+    else limit -= limit / 8;
+    if (limit < BB_SPIN_MIN) limit = BB_SPIN_MIN;
+    if (limit > BB_SPIN_MAX) limit = BB_SPIN_MAX;
+    atomic_store_explicit(&e->spin_limit, limit, memory_order_relaxed);
+}
+
+/* Bounded lock-free ring. BB_SPSC is a single-producer/single-consumer ring where each
+   side keeps a private copy of the other side's index and only rereads it when the ring
+   looks full or empty. BB_MPMC uses a sequence number per slot (Vyukov's bounded queue). */
+typedef enum { BB_SPSC, BB_MPMC } BBMode;
+
+typedef struct {
+    int seq;    // position in the source stream
+    int val;
+    long long t_ns;   // when the item was produced
+} Item;
+
+typedef struct {
+    _Atomic size_t seq;
+    Item val;
+} BBSlot;
+
+typedef struct {
+    BBMode mode;
+    size_t cap;
+    Item *data;                         // SPSC slots
+    BBSlot *slots;                      // MPMC slots
+    _Alignas(64) _Atomic size_t head;   // next position to read
+    size_t cached_tail;                 // consumer's copy of tail (SPSC)
+    _Alignas(64) _Atomic size_t tail;   // next position to write
+    size_t cached_head;                 // producer's copy of head (SPSC)
+    _Alignas(64) BBEvent not_full;
+    BBEvent not_empty;
+    _Atomic int closed;                 // no more puts; getters drain then see EOF
 } BoundedBuffer;
 
-static BoundedBuffer buf1, buf2;
 static int next_to_produce = 0;
 static int processed_count = 0;
 static int consumed_count = 0;
+static int *logarr = NULL;
+static int n_items = N;
+static int quiet = 0;              // benchmark: no per-item output, no log
+static long long deadline_ns = 0;  // benchmark by duration: stop producing at this time
 
 static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static FILE *logf = NULL;
 
-void bb_init(BoundedBuffer *b, int cap) {
-    b->data = (int*)malloc(sizeof(int) * cap);
-    b->cap = cap; b->head = b->tail = b->count = 0;
-    pthread_mutex_init(&b->m, NULL);
-    pthread_cond_init(&b->not_full, NULL);
-    pthread_cond_init(&b->not_empty, NULL);
+void bb_init_mode(BoundedBuffer *b, int cap, BBMode mode) {
+    b->mode = mode;
+    b->cap = (size_t)cap;
+    b->data = NULL;
+    b->slots = NULL;
+    if (mode == BB_SPSC) b->data = (Item*)malloc(sizeof(Item) * cap);
+    else {
+        b->slots = (BBSlot*)malloc(sizeof(BBSlot) * cap);
+        for (int i = 0; i < cap; i++) atomic_init(&b->slots[i].seq, (size_t)i);
+    }
+    atomic_init(&b->head, 0);
+    atomic_init(&b->tail, 0);
+    b->cached_head = b->cached_tail = 0;
+    ev_init(&b->not_full);
+    ev_init(&b->not_empty);
+    atomic_init(&b->closed, 0);
 }
+void bb_init(BoundedBuffer *b, int cap) { bb_init_mode(b, cap, BB_MPMC); }
 void bb_destroy(BoundedBuffer *b) {
     free(b->data);
-    pthread_mutex_destroy(&b->m);
-    pthread_cond_destroy(&b->not_full);
-    pthread_cond_destroy(&b->not_empty);
-}
-void bb_put(BoundedBuffer *b, int x) {
-    pthread_mutex_lock(&b->m);
-    while (b->count == b->cap) pthread_cond_wait(&b->not_full, &b->m);
-    b->data[b->tail] = x;
-    b->tail = (b->tail + 1) % b->cap;
-    b->count++;
-    pthread_cond_signal(&b->not_empty);
-    pthread_mutex_unlock(&b->m);
-}
-int bb_get(BoundedBuffer *b) {
-    pthread_mutex_lock(&b->m);
-    while (b->count == 0) pthread_cond_wait(&b->not_empty, &b->m);
-    int x = b->data[b->head];
-    b->head = (b->head + 1) % b->cap;
-    b->count--;
-    pthread_cond_signal(&b->not_full);
-    pthread_mutex_unlock(&b->m);
-    return x;
-}
-
-void* producer(void* arg) {
-    long id = (long)arg;
+    free(b->slots);
+    ev_destroy(&b->not_full);
+    ev_destroy(&b->not_empty);
+}
+
+/* Ring operations move up to n items with one publish: the SPSC ring advances its index
+   once, the MPMC ring claims a run of free (or full) slots with a single CAS. They return
+   the number of items moved and never block. */
+static int ring_put(BoundedBuffer *b, const Item *xs, int n) {
+    if (b->mode == BB_SPSC) {
+        size_t t = atomic_load_explicit(&b->tail, memory_order_relaxed);
+        size_t room = b->cap - (t - b->cached_head);
+        if (room < (size_t)n) {
+            b->cached_head = atomic_load_explicit(&b->head, memory_order_acquire);
+            room = b->cap - (t - b->cached_head);
+            if (room == 0) return 0;
+        }
+        int k = room < (size_t)n ? (int)room : n;
+        for (int i = 0; i < k; i++) b->data[(t + i) % b->cap] = xs[i];
+        atomic_store_explicit(&b->tail, t + k, memory_order_release);
+        return k;
+    }
+    size_t pos = atomic_load_explicit(&b->tail, memory_order_relaxed);
+    int k;
     for (;;) {
-        int my_index;
-        pthread_mutex_lock(&count_lock);
-        if (next_to_produce >= N) {
-            pthread_mutex_unlock(&count_lock);
-            break;
+        intptr_t diff = 0;
+        for (k = 0; k < n; k++) {
+            BBSlot *s = &b->slots[(pos + k) % b->cap];
+            diff = (intptr_t)atomic_load_explicit(&s->seq, memory_order_acquire) - (intptr_t)(pos + k);
+            if (diff != 0) break;
         }
-        my_index = next_to_produce++;
-        pthread_mutex_unlock(&count_lock);
-
-        int val = rand() % 100;
-        bb_put(&buf1, val);
+        if (k > 0) {
+            if (atomic_compare_exchange_weak_explicit(&b->tail, &pos, pos + k,
+                                                      memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return 0;   // full
+        else pos = atomic_load_explicit(&b->tail, memory_order_relaxed);
+    }
+    for (int i = 0; i < k; i++) {
+        BBSlot *s = &b->slots[(pos + i) % b->cap];
+        s->val = xs[i];
+        atomic_store_explicit(&s->seq, pos + i + 1, memory_order_release);
+    }
+    return k;
+}
 
-        pthread_mutex_lock(&print_lock);
-        printf("Producer %ld produced: %d (total produced: %d)\n",
-               id, val, my_index + 1);
-        pthread_mutex_unlock(&print_lock);
-        // (Optional) tiny sleep to interleave outputs
-        // usleep(1000);
+static int ring_get(BoundedBuffer *b, Item *xs, int n) {
+    if (b->mode == BB_SPSC) {
+        size_t h = atomic_load_explicit(&b->head, memory_order_relaxed);
+        size_t avail = b->cached_tail - h;
+        if (avail < (size_t)n) {
+            b->cached_tail = atomic_load_explicit(&b->tail, memory_order_acquire);
+            avail = b->cached_tail - h;
+            if (avail == 0) return 0;
+        }
+        int k = avail < (size_t)n ? (int)avail : n;
+        for (int i = 0; i < k; i++) xs[i] = b->data[(h + i) % b->cap];
+        atomic_store_explicit(&b->head, h + k, memory_order_release);
+        return k;
     }
-    return NULL;
+    size_t pos = atomic_load_explicit(&b->head, memory_order_relaxed);
+    int k;
+    for (;;) {
+        intptr_t diff = 0;
+        for (k = 0; k < n; k++) {
+            BBSlot *s = &b->slots[(pos + k) % b->cap];
+            diff = (intptr_t)atomic_load_explicit(&s->seq, memory_order_acquire) - (intptr_t)(pos + k + 1);
+            if (diff != 0) break;
+        }
+        if (k > 0) {
+            if (atomic_compare_exchange_weak_explicit(&b->head, &pos, pos + k,
+                                                      memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return 0;   // empty
+        else pos = atomic_load_explicit(&b->head, memory_order_relaxed);
+    }
+    for (int i = 0; i < k; i++) {
+        BBSlot *s = &b->slots[(pos + i) % b->cap];
+        xs[i] = s->val;
+        atomic_store_explicit(&s->seq, pos + i + b->cap, memory_order_release);
+    }
+    return k;
+}
+
+// Non-blocking: move as many of the n items as fit (are available) right now.
+int bb_try_put_many(BoundedBuffer *b, const Item *xs, int n) {
+    int k = ring_put(b, xs, n);
+    if (k > 0) ev_notify(&b->not_empty, k);
+    return k;
+}
+int bb_try_get_many(BoundedBuffer *b, Item *xs, int max) {
+    int k = ring_get(b, xs, max);
+    if (k > 0) ev_notify(&b->not_full, k);
+    return k;
 }
 
-void* processor(void* arg) {
-    long id = (long)arg;
+// Put all n items, blocking while the buffer is full.
+void bb_put_many(BoundedBuffer *b, const Item *xs, int n) {
+    BBWaiter w;
+    wt_begin(&w);
+    while (n > 0) {
+        int k = bb_try_put_many(b, xs, n);
+        if (k == 0 && wt_backoff(&b->not_full, &w)) {
+            uint32_t seen = ev_prepare(&b->not_full);
+            k = bb_try_put_many(b, xs, n);
+            if (k == 0) { ev_wait(&b->not_full, seen); continue; }
+            ev_cancel(&b->not_full);
+        }
+        if (k == 0) continue;
+        wt_end(&b->not_full, &w);
+        wt_begin(&w);
+        xs += k;
+        n -= k;
+    }
+}
+// Block until at least one item is available, then take up to max. Returns 0 once the
+// buffer is closed and drained.
+int bb_get_many(BoundedBuffer *b, Item *xs, int max) {
+    BBWaiter w;
+    wt_begin(&w);
     for (;;) {
-        int x = bb_get(&buf1);
-        if (x == -1) {
-            // Sentinel: stop this processor.
-            break;
+        int k = bb_try_get_many(b, xs, max);
+        if (k == 0 && atomic_load_explicit(&b->closed, memory_order_acquire))
+            k = bb_try_get_many(b, xs, max);
+        else if (k == 0 && wt_backoff(&b->not_empty, &w)) {
+            uint32_t seen = ev_prepare(&b->not_empty);
+            k = bb_try_get_many(b, xs, max);
+            if (k == 0 && !atomic_load(&b->closed)) { ev_wait(&b->not_empty, seen); continue; }
+            ev_cancel(&b->not_empty);
+            if (k == 0) continue;
         }
-        int y = x * x;
-        bb_put(&buf2, y);
+        else if (k == 0) continue;
+        wt_end(&b->not_empty, &w);
+        return k;
+    }
+}
+
+void bb_put(BoundedBuffer *b, Item x) { bb_put_many(b, &x, 1); }
+int bb_get(BoundedBuffer *b, Item *x) { return bb_get_many(b, x, 1); }
+
+// Called once after the last put; wakes every parked getter.
+void bb_close(BoundedBuffer *b) {
+    atomic_store_explicit(&b->closed, 1, memory_order_release);
+    ev_notify(&b->not_empty, INT_MAX);
+}
+
+// Items currently queued (a snapshot; exact only when no one is moving items).
+static size_t bb_size(BoundedBuffer *b) {
+    size_t t = atomic_load_explicit(&b->tail, memory_order_relaxed);
+    size_t h = atomic_load_explicit(&b->head, memory_order_relaxed);
+    return t > h ? t - h : 0;
+}
+
+/* Pipeline runtime. A stage is a function run by `threads` workers; consecutive stages are
+   joined by a ring of `depth` items (SPSC when both sides have one worker). A stage function
+   gets a batch of n input items and writes its outputs (at most n) to out, returning how many.
+   The first stage gets in == NULL and may produce up to n items; returning 0 ends the stream.
+   When the last worker of a stage exits it closes its output queue, so end of stream flows
+   down the pipeline without sentinels. */
+typedef struct Stage Stage;
+typedef int (*StageFn)(Stage *s, int worker, const Item *in, int n, Item *out);
+
+typedef struct {
+    _Alignas(64) long long items, batches;
+    long long wait_in_ns, wait_out_ns;  // time parked on an empty input / full output queue
+    long long occ_sum;                  // input queue length seen at each batch
+    long long steals;                   // batches taken from another worker's deque
+} StageStats;
+
+/* Work-stealing stages give each worker a deque. A worker refills its empty deque with
+   WS_GRAB items from the input queue in one operation, works from the front, and when it
+   has nothing left steals up to half of another worker's deque from the back. The lock is
+   only contended while stealing. */
+typedef struct {
+    _Alignas(64) pthread_mutex_t m;
+    Item buf[WS_GRAB];
+    int head, count;
+} WSDeque;
+
+/* Reorder buffer for an ordered stage: items are held by sequence number until every
+   earlier item has arrived. Grows when items arrive too far ahead of the next expected. */
+typedef struct {
+    Item *slot;
+    char *full;
+    int cap, next, count, peak;
+} Reorder;
+
+struct Stage {
+    const char *name;
+    StageFn fn;
+    int threads, depth, cpu;            // cpu: first CPU to pin workers to, -1 = unpinned
+    int steal;                          // per-worker deques with work stealing
+    int ordered;                        // single worker sees items in sequence order
+    BoundedBuffer *in, *out;
+    _Atomic int live;
+    WSDeque *deques;
+    Reorder rob;
+    pthread_t tid[MAX_STAGE_THREADS];
+    StageStats stats[MAX_STAGE_THREADS];
+};
+
+typedef struct {
+    Stage stages[MAX_STAGES];
+    BoundedBuffer queues[MAX_STAGES];
+    int n;
+    double secs;
+} Pipeline;
+
+typedef struct { Stage *s; int idx; } WorkerArg;
 
-        int now_processed;
-        pthread_mutex_lock(&count_lock);
-        now_processed = ++processed_count;
-        pthread_mutex_unlock(&count_lock);
+Stage *pipeline_add(Pipeline *p, const char *name, StageFn fn, int threads, int depth, int cpu) {
+    if (p->n == MAX_STAGES || threads < 1 || threads > MAX_STAGE_THREADS) return NULL;
+    Stage *s = &p->stages[p->n++];
+    s->name = name;
+    s->fn = fn;
+    s->threads = threads;
+    s->depth = depth;
+    s->cpu = cpu;
+    return s;
+}
+
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % CPU_SETSIZE, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+#else
+    (void)cpu;   // no portable affinity API; workers stay unpinned
+#endif
+}
+
+static int dq_pop(WSDeque *d, Item *out, int max) {
+    pthread_mutex_lock(&d->m);
+    int k = d->count < max ? d->count : max;
+    for (int i = 0; i < k; i++) out[i] = d->buf[(d->head + i) % WS_GRAB];
+    d->head = (d->head + k) % WS_GRAB;
+    d->count -= k;
+    pthread_mutex_unlock(&d->m);
+    return k;
+}
+
+static int dq_steal(WSDeque *d, Item *out, int max) {
+    pthread_mutex_lock(&d->m);
+    int k = (d->count + 1) / 2;
+    if (k > max) k = max;
+    d->count -= k;
+    for (int i = 0; i < k; i++) out[i] = d->buf[(d->head + d->count + i) % WS_GRAB];
+    pthread_mutex_unlock(&d->m);
+    return k;
+}
 
-        pthread_mutex_lock(&print_lock);
-        printf("Processor %ld processed %d -> %d (total processed: %d)\n",
-               id, x, y, now_processed);
-        pthread_mutex_unlock(&print_lock);
+// Own deque first, then a refill from the input queue, then steal. Never blocks.
+static int ws_next(Stage *s, int idx, Item *in) {
+    WSDeque *d = &s->deques[idx];
+    int n = dq_pop(d, in, BATCH);
+    if (n > 0) return n;
+    Item grab[WS_GRAB];
+    int k = bb_try_get_many(s->in, grab, WS_GRAB);
+    if (k > 0) {
+        n = k < BATCH ? k : BATCH;
+        for (int i = 0; i < n; i++) in[i] = grab[i];
+        pthread_mutex_lock(&d->m);
+        for (int i = n; i < k; i++) d->buf[(d->head + d->count++) % WS_GRAB] = grab[i];
+        pthread_mutex_unlock(&d->m);
+        return n;
     }
-    return NULL;
+    for (int j = 1; j < s->threads; j++) {
+        n = dq_steal(&s->deques[(idx + j) % s->threads], in, BATCH);
+        if (n > 0) { s->stats[idx].steals++; return n; }
+    }
+    return 0;
 }
 
-void* consumer(void* arg) {
-    (void)arg;
-    int *logarr = (int*)malloc(sizeof(int)*N);
-    int idx = 0;
-    while (1) {
-        if (idx >= N) break; // consumed exactly N
-        int y = bb_get(&buf2);
-        logarr[idx++] = y;
+static void rob_put(Reorder *r, const Item *in, int n) {
+    for (int i = 0; i < n; i++) {
+        if (in[i].seq - r->next >= r->cap) {
+            int cap = r->cap ? r->cap : 64;
+            while (in[i].seq - r->next >= cap) cap *= 2;
+            Item *slot = (Item*)malloc(sizeof(Item) * cap);
+            char *full = (char*)calloc(cap, 1);
+            for (int j = 0; j < r->cap; j++)
+                if (r->full[j]) { slot[r->slot[j].seq % cap] = r->slot[j]; full[r->slot[j].seq % cap] = 1; }
+            free(r->slot);
+            free(r->full);
+            r->slot = slot;
+            r->full = full;
+            r->cap = cap;
+        }
+        r->slot[in[i].seq % r->cap] = in[i];
+        r->full[in[i].seq % r->cap] = 1;
+        if (++r->count > r->peak) r->peak = r->count;
+    }
+}
 
-        int now_consumed;
-        pthread_mutex_lock(&count_lock);
-        now_consumed = ++consumed_count;
-        pthread_mutex_unlock(&count_lock);
+// Take the next in-order run; at end of stream (drain) skip over missing sequence numbers.
+static int rob_take(Reorder *r, Item *out, int max, int drain) {
+    int k = 0;
+    while (drain && r->count > 0 && !r->full[r->next % r->cap]) r->next++;
+    while (k < max && r->count > 0 && r->full[r->next % r->cap]) {
+        out[k++] = r->slot[r->next % r->cap];
+        r->full[r->next++ % r->cap] = 0;
+        r->count--;
+    }
+    return k;
+}
 
-        pthread_mutex_lock(&print_lock);
-        printf("Consumer consumed: %d (total consumed: %d)\n",
-               y, now_consumed);
-        pthread_mutex_unlock(&print_lock);
+static void flush_out(Stage *s, StageStats *st, Item *pend, int *np) {
+    if (*np == 0 || !s->out) { *np = 0; return; }
+    int k = bb_try_put_many(s->out, pend, *np);
+    if (k < *np) {
+        long long t0 = now_ns();
+        bb_put_many(s->out, pend + k, *np - k);
+        st->wait_out_ns += now_ns() - t0;
     }
-    // write log
-    for (int i = 0; i < N; i++) fprintf(logf, "%d\n", logarr[i]);
-    free(logarr);
+    *np = 0;
+}
+
+// Next input batch for a worker; 0 at end of stream.
+static int stage_input(Stage *s, int idx, Item *in, Item *pend, int *np) {
+    StageStats *st = &s->stats[idx];
+    for (;;) {
+        int n;
+        if (s->ordered && (n = rob_take(&s->rob, in, BATCH, 0)) > 0) return n;
+        n = s->deques ? ws_next(s, idx, in) : bb_try_get_many(s->in, in, BATCH);
+        if (n == 0) {
+            flush_out(s, st, pend, np);
+            long long t0 = now_ns();
+            n = bb_get_many(s->in, in, BATCH);
+            st->wait_in_ns += now_ns() - t0;
+            if (n == 0) return s->ordered ? rob_take(&s->rob, in, BATCH, 1) : 0;
+        }
+        st->occ_sum += (long long)bb_size(s->in);
+        if (!s->ordered) return n;
+        rob_put(&s->rob, in, n);
+    }
+}
+
+/* Outputs collect in pend until a batch is full, the input runs dry, or the oldest pending
+   item has waited BATCH_FLUSH_NS. */
+static void *stage_worker(void *arg) {
+    WorkerArg *w = (WorkerArg*)arg;
+    Stage *s = w->s;
+    StageStats *st = &s->stats[w->idx];
+    Item in[BATCH], pend[2 * BATCH];
+    int np = 0;
+    long long oldest = 0;
+    if (s->cpu >= 0) pin_to_cpu(s->cpu + w->idx);
+    for (;;) {
+        int n = s->in ? stage_input(s, w->idx, in, pend, &np) : BATCH;
+        if (n == 0) break;
+        int m = s->fn(s, w->idx, s->in ? in : NULL, n, pend + np);
+        if (!s->in && m == 0) break;
+        st->items += s->in ? n : m;
+        st->batches++;
+        if (m > 0 && np == 0) oldest = now_ns();
+        np += m;
+        if (np >= BATCH || !s->in || (np > 0 && now_ns() - oldest >= BATCH_FLUSH_NS))
+            flush_out(s, st, pend, &np);
+    }
+    flush_out(s, st, pend, &np);
+    if (atomic_fetch_sub(&s->live, 1) == 1 && s->out) bb_close(s->out);
     return NULL;
 }
 
-int main(void) {
-    srand((unsigned)time(NULL));
-    logf = fopen("log.txt", "w");
-    if (!logf) { perror("log.txt"); return 1; }
+void pipeline_run(Pipeline *p) {
+    WorkerArg args[MAX_STAGES][MAX_STAGE_THREADS];
+    for (int i = 0; i < p->n; i++) {
+        Stage *s = &p->stages[i];
+        s->in = NULL;
+        s->out = NULL;
+        s->deques = NULL;
+        memset(s->stats, 0, sizeof s->stats);
+        memset(&s->rob, 0, sizeof s->rob);
+        atomic_init(&s->live, s->threads);
+        if (i > 0) {
+            Stage *up = &p->stages[i - 1];
+            bb_init_mode(&p->queues[i], s->depth,
+                         up->threads == 1 && s->threads == 1 ? BB_SPSC : BB_MPMC);
+            s->in = up->out = &p->queues[i];
+            if (s->steal && s->threads > 1) {
+                s->deques = (WSDeque*)calloc(s->threads, sizeof(WSDeque));
+                for (int t = 0; t < s->threads; t++) pthread_mutex_init(&s->deques[t].m, NULL);
+            }
+        }
+        if (s->threads > 1 || i == 0) s->ordered = 0;   // reordering needs one worker with an input
+    }
+    long long t0 = now_ns();
+    for (int i = 0; i < p->n; i++)
+        for (int t = 0; t < p->stages[i].threads; t++) {
+            args[i][t] = (WorkerArg){ &p->stages[i], t };
+            pthread_create(&p->stages[i].tid[t], NULL, stage_worker, &args[i][t]);
+        }
+    for (int i = 0; i < p->n; i++)
+        for (int t = 0; t < p->stages[i].threads; t++) pthread_join(p->stages[i].tid[t], NULL);
+    p->secs = (now_ns() - t0) / 1e9;
+    for (int i = 1; i < p->n; i++) {
+        Stage *s = &p->stages[i];
+        bb_destroy(&p->queues[i]);
+        if (s->deques)
+            for (int t = 0; t < s->threads; t++) pthread_mutex_destroy(&s->deques[t].m);
+        free(s->deques);
+        free(s->rob.slot);
+        free(s->rob.full);
+    }
+}
 
-    bb_init(&buf1, BUF1_SIZE);
-    bb_init(&buf2, BUF2_SIZE);
+/* Per stage: throughput, mean input queue length as a share of its depth, and the share of
+   worker time parked on input and on output. The stage with little blocked-on-input time
+   and full upstream queue is the bottleneck. */
+void pipeline_report(const Pipeline *p) {
+    printf("%-10s %4s %10s %12s %10s %11s %12s\n",
+           "Stage", "Thr", "Items", "Items/s", "Queue occ", "Blocked in", "Blocked out");
+    for (int i = 0; i < p->n; i++) {
+        const Stage *s = &p->stages[i];
+        long long items = 0, batches = 0, win = 0, wout = 0, occ = 0;
+        for (int t = 0; t < s->threads; t++) {
+            items += s->stats[t].items;
+            batches += s->stats[t].batches;
+            win += s->stats[t].wait_in_ns;
+            wout += s->stats[t].wait_out_ns;
+            occ += s->stats[t].occ_sum;
+        }
+        double thread_ns = p->secs * 1e9 * s->threads;
+        printf("%-10s %4d %10lld %12.0f ", s->name, s->threads, items, items / p->secs);
+        if (i > 0 && batches > 0) printf("%9.1f%% %10.1f%% ", 100.0 * occ / batches / s->depth, 100.0 * win / thread_ns);
+        else printf("%10s %11s ", "-", "-");
+        if (i + 1 < p->n) printf("%11.1f%%\n", 100.0 * wout / thread_ns);
+        else printf("%12s\n", "-");
+    }
+    for (int i = 1; i < p->n; i++) {
+        const BoundedBuffer *q = p->stages[i].in;
+        printf("Queue -> %-10s spin limit put %d / get %d, parks put %ld / get %ld\n",
+               p->stages[i].name, atomic_load(&q->not_full.spin_limit), atomic_load(&q->not_empty.spin_limit),
+               atomic_load(&q->not_full.parks), atomic_load(&q->not_empty.parks));
+    }
+    for (int i = 1; i < p->n; i++) {
+        const Stage *s = &p->stages[i];
+        long long steals = 0;
+        for (int t = 0; t < s->threads; t++) steals += s->stats[t].steals;
+        if (s->steal && s->threads > 1) printf("%s: work stealing, %lld batches stolen\n", s->name, steals);
+        if (s->ordered) printf("%s: in order, reorder buffer peak %d items\n", s->name, s->rob.peak);
+    }
+}
+
+static Hist *hists = NULL;   // one per consumer worker, merged after the run
+
+// Lab stages: random values -> squares -> log.
+static int produce(Stage *s, int worker, const Item *in, int n, Item *out) {
+    (void)s; (void)in;
+    int first;
+    if (deadline_ns && now_ns() >= deadline_ns) return 0;
+    pthread_mutex_lock(&count_lock);
+    first = next_to_produce;
+    if (n > n_items - first) n = n_items - first;
+    if (n < 0) n = 0;
+    next_to_produce += n;
+    pthread_mutex_unlock(&count_lock);
+    if (n == 0) return 0;
+
+    long long t = now_ns();
+    // rand() takes a lock in glibc, so the benchmark uses a cheap deterministic value
+    for (int i = 0; i < n; i++) out[i] = (Item){ first + i, quiet ? (first + i) % 100 : rand() % 100, t };
+    if (quiet) return n;
+    pthread_mutex_lock(&print_lock);
+    for (int i = 0; i < n; i++)
+        printf("Producer %d produced: %d (total produced: %d)\n",
+               worker + 1, out[i].val, first + i + 1);
+    pthread_mutex_unlock(&print_lock);
+    return n;
+}
+
+static int square(Stage *s, int worker, const Item *in, int n, Item *out) {
+    (void)s;
+    int base;
+    pthread_mutex_lock(&count_lock);
+    base = processed_count;
+    processed_count += n;
+    pthread_mutex_unlock(&count_lock);
+
+    for (int i = 0; i < n; i++) out[i] = (Item){ in[i].seq, in[i].val * in[i].val, in[i].t_ns };
+    if (quiet) return n;
+    pthread_mutex_lock(&print_lock);
+    for (int i = 0; i < n; i++)
+        printf("Processor %d processed %d -> %d (total processed: %d)\n",
+               worker + 1, in[i].val, out[i].val, base + i + 1);
+    pthread_mutex_unlock(&print_lock);
+    return n;
+}
+
+static int consume(Stage *s, int worker, const Item *in, int n, Item *out) {
+    (void)s; (void)out;
+    int base;
+    pthread_mutex_lock(&count_lock);
+    base = consumed_count;
+    consumed_count += n;
+    pthread_mutex_unlock(&count_lock);
 
-    pthread_t prod[NUM_PRODUCERS], proc[NUM_PROCESSORS], cons;
+    if (quiet) {
+        long long t = now_ns();
+        for (int i = 0; i < n; i++) hist_add(&hists[worker], t - in[i].t_ns);
+        return 0;
+    }
+    for (int i = 0; i < n; i++) logarr[base + i] = in[i].val;
+    pthread_mutex_lock(&print_lock);
+    for (int i = 0; i < n; i++)
+        printf("Consumer consumed: %d (total consumed: %d)\n", in[i].val, base + i + 1);
+    pthread_mutex_unlock(&print_lock);
+    return 0;
+}
 
-    for (long i = 1; i <= NUM_PRODUCERS; i++)
-        pthread_create(&prod[i-1], NULL, producer, (void*)i);
+/* One benchmark run: items/s and end-to-end latency (production to consumption). */
+static void run_bench(int producers, int processors, int consumers, int depth, int cpu,
+                      int steal, int ordered, long long duration_ns, int report) {
+    static Pipeline p;
+    memset(&p, 0, sizeof p);
+    next_to_produce = processed_count = consumed_count = 0;
+    hists = (Hist*)calloc(consumers, sizeof(Hist));
+    pipeline_add(&p, "produce", produce, producers, 0, cpu);
+    Stage *proc = pipeline_add(&p, "square", square, processors, depth, cpu < 0 ? -1 : cpu + producers);
+    Stage *cons = pipeline_add(&p, "consume", consume, consumers, depth, cpu < 0 ? -1 : cpu + producers + processors);
+    proc->steal = steal;
+    cons->ordered = ordered;
+    deadline_ns = duration_ns ? now_ns() + duration_ns : 0;
+    pipeline_run(&p);
 
-    for (long i = 1; i <= NUM_PROCESSORS; i++)
-        pthread_create(&proc[i-1], NULL, processor, (void*)i);
+    Hist *h = &hists[0];
+    for (int c = 1; c < consumers; c++) hist_merge(h, &hists[c]);
+    printf("%6d %3d %3d %3d %12.0f %10.1f %10.1f %10.1f %10.1f\n",
+           depth, producers, processors, consumers, consumed_count / p.secs,
+           hist_percentile(h, 0.50) / 1e3, hist_percentile(h, 0.99) / 1e3,
+           hist_percentile(h, 0.999) / 1e3, h->max / 1e3);
+    if (report) pipeline_report(&p);
+    free(hists);
+}
 
-    pthread_create(&cons, NULL, consumer, NULL);
+int main(int argc, char **argv) {
+    int producers = NUM_PRODUCERS, processors = NUM_PROCESSORS, consumers = NUM_CONSUMERS;
+    int depth1 = BUF1_SIZE, depth2 = BUF2_SIZE, cpu = -1, steal = 0, ordered = 0, opt;
+    int bench = 0, sweep = 0;
+    double secs = 0;
+    const char *usage = "Usage: %s [-p producers] [-w processors] [-c consumers] [-d queue_depth] [-a first_cpu] [-s] [-o]\n"
+                        "          [-b] [-n items] [-t seconds] [-S]\n"
+                        "       -s: processors use work-stealing deques, -o: consumer sees items in order (needs -c 1)\n"
+                        "       -b: benchmark (no per-item output), -n/-t: item count or duration, -S: sweep depths and processors\n";
+    while ((opt = getopt(argc, argv, "p:w:c:d:a:sobn:t:S")) != -1) {
+        switch (opt) {
+            case 'p': producers = atoi(optarg); break;
+            case 'w': processors = atoi(optarg); break;
+            case 'c': consumers = atoi(optarg); break;
+            case 'd': depth1 = depth2 = atoi(optarg); break;
+            case 'a': cpu = atoi(optarg); break;
+            case 's': steal = 1; break;
+            case 'o': ordered = 1; break;
+            case 'b': bench = 1; break;
+            case 'n': n_items = atoi(optarg); break;
+            case 't': bench = 1; secs = atof(optarg); break;
+            case 'S': bench = sweep = 1; break;
+            default: fprintf(stderr, usage, argv[0]); return 1;
+        }
+    }
+    int threads[3] = { producers, processors, consumers };
+    for (int s = 0; s < 3; s++)
+        if (threads[s] < 1 || threads[s] > MAX_STAGE_THREADS) {
+            fprintf(stderr, "Each stage needs 1 to %d threads\n", MAX_STAGE_THREADS);
+            return 1;
+        }
+    if (depth1 < 1 || n_items < 1 || (ordered && consumers != 1)) { fprintf(stderr, usage, argv[0]); return 1; }
 
-    // Wait producers, then inject sentinels for processors:
-    for (int i = 0; i < NUM_PRODUCERS; i++) pthread_join(prod[i], NULL);
-    for (int s = 0; s < NUM_PROCESSORS; s++) bb_put(&buf1, -1);
+    if (bench) {
+        quiet = 1;
+        if (secs > 0) n_items = INT_MAX;
+        else if (n_items == N) n_items = 1000000;
+        printf("Benchmark: %s, %s%s\n", secs > 0 ? "fixed duration" : "fixed item count",
+               steal ? "work stealing" : "shared input", ordered ? ", in order" : "");
+        printf("%6s %3s %3s %3s %12s %10s %10s %10s %10s\n",
+               "Depth", "P", "W", "C", "Items/s", "p50 us", "p99 us", "p999 us", "max us");
+        if (!sweep) {
+            run_bench(producers, processors, consumers, depth1, cpu, steal, ordered, (long long)(secs * 1e9), 1);
+            return 0;
+        }
+        static const int depths[] = { 4, 16, 64, 256 }, workers[] = { 1, 2, 4 };
+        for (int d = 0; d < 4; d++)
+            for (int w = 0; w < 3; w++)
+                run_bench(producers, workers[w], consumers, depths[d], cpu, steal, ordered, (long long)(secs * 1e9), 0);
+        return 0;
+    }
+
+    srand((unsigned)time(NULL));
+    logf = fopen("log.txt", "w");
+    if (!logf) { perror("log.txt"); return 1; }
+    logarr = (int*)malloc(sizeof(int) * n_items);
 
-    for (int i = 0; i < NUM_PROCESSORS; i++) pthread_join(proc[i], NULL);
-    pthread_join(cons, NULL);
+    // With -a, each stage's workers get consecutive CPUs starting at first_cpu.
+    static Pipeline p;
+    Stage *prod = pipeline_add(&p, "produce", produce, producers, 0, cpu);
+    Stage *proc = pipeline_add(&p, "square", square, processors, depth1, cpu < 0 ? -1 : cpu + producers);
+    Stage *cons = pipeline_add(&p, "consume", consume, consumers, depth2, cpu < 0 ? -1 : cpu + producers + processors);
+    if (!prod || !proc || !cons) { fprintf(stderr, usage, argv[0]); return 1; }
+    proc->steal = steal;
+    cons->ordered = ordered;
+    pipeline_run(&p);
 
     pthread_mutex_lock(&print_lock);
     printf("=== Simulation Complete ===\n");
     printf("Produced: %d | Processed: %d | Consumed: %d\n",
            next_to_produce, processed_count, consumed_count);
+    pipeline_report(&p);
     printf("Results written to log.txt\n");
     pthread_mutex_unlock(&print_lock);
 
-    bb_destroy(&buf1);
-    bb_destroy(&buf2);
+    for (int i = 0; i < n_items; i++) fprintf(logf, "%d\n", logarr[i]);
+    free(logarr);
     fclose(logf);
     return 0;
-}
\ No newline at end of file
+}
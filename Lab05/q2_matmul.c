@@ -1,6 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define MB 64                 // rows of C per tile
+#define NB 64                 // columns of C per tile = width of a packed B panel
+#define KB 256                // depth of A and B consumed per pass over a tile
+#define CELL_BENCH_MAX 16384  // largest M*N the per-cell mode is benchmarked at
+#define REC_LEAF 128          // recursive mode: blocks of at most REC_LEAF^3 use the tiled kernel
+#define STRASSEN_CUTOFF 256   // default size at which Strassen-Winograd switches to the tiled kernel
+#define SPARSE_DENSITY 0.10   // auto mode: A with fewer non-zeros than this uses CSR x dense
+#define SPGEMM_DENSITY 0.20   // auto mode: A and B both below this use CSR x CSR
+#define CHUNKS_PER_THREAD 4   // sparse modes: nnz-balanced row chunks per pool thread
 
 static int **A, **B, **C;
 static int M, K, N;
@@ -20,6 +44,92 @@ void free_matrix(int **m) {
     free(m[0]);free(m);
 }
 
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fixed-size worker pool. pool_run hands out task indices 0..ntasks-1 through an atomic
+   counter; the calling thread works on tasks too and returns when all are finished. */
+typedef struct {
+    pthread_t *threads;
+    int nthreads;
+    pthread_mutex_t m;
+    pthread_cond_t work, done;
+    void (*fn)(void *ctx, int task);
+    void *ctx;
+    int ntasks, active, stop;
+    long generation;
+    _Atomic int next;
+} Pool;
+
+static void pool_drain(Pool *p) {
+    for (int t; (t = atomic_fetch_add(&p->next, 1)) < p->ntasks;) p->fn(p->ctx, t);
+}
+
+static void* pool_worker(void *arg) {
+    Pool *p = (Pool*)arg;
+    long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&p->m);
+        while (!p->stop && p->generation == seen) pthread_cond_wait(&p->work, &p->m);
+        if (p->stop) { pthread_mutex_unlock(&p->m); return NULL; }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->m);
+
+        pool_drain(p);
+
+        pthread_mutex_lock(&p->m);
+        if (--p->active == 0) pthread_cond_signal(&p->done);
+        pthread_mutex_unlock(&p->m);
+    }
+}
+
+int pool_init(Pool *p, int nthreads) {
+    memset(p, 0, sizeof *p);
+    pthread_mutex_init(&p->m, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->nthreads = nthreads - 1;   // the caller is the last worker
+    p->threads = (pthread_t*)malloc(sizeof(pthread_t) * (p->nthreads > 0 ? p->nthreads : 1));
+    if (!p->threads) return -1;
+    for (int i = 0; i < p->nthreads; i++)
+        if (pthread_create(&p->threads[i], NULL, pool_worker, p) != 0) return -1;
+    return 0;
+}
+
+void pool_run(Pool *p, int ntasks, void (*fn)(void*, int), void *ctx) {
+    pthread_mutex_lock(&p->m);
+    p->fn = fn;
+    p->ctx = ctx;
+    p->ntasks = ntasks;
+    atomic_store(&p->next, 0);
+    p->active = p->nthreads;
+    p->generation++;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->m);
+
+    pool_drain(p);
+
+    pthread_mutex_lock(&p->m);
+    while (p->active > 0) pthread_cond_wait(&p->done, &p->m);
+    pthread_mutex_unlock(&p->m);
+}
+
+void pool_destroy(Pool *p) {
+    pthread_mutex_lock(&p->m);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->m);
+    for (int i = 0; i < p->nthreads; i++) pthread_join(p->threads[i], NULL);
+    free(p->threads);
+    pthread_mutex_destroy(&p->m);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->done);
+}
+
+// Original mode: one thread per cell of C.
 void* worker(void* arg) {
     Cell *cell = (Cell*)arg;
     int i = cell->i, j = cell->j;
@@ -30,49 +140,924 @@ void* worker(void* arg) {
     return NULL;
 }
 
-int main(void) {
-    printf("Enter M K N: ");
-    if (scanf("%d %d %d", &M, &K, &N) != 3 || M<=0 || K<=0 || N<=0) {
-        fprintf(stderr, "Invalid sizes\n"); return 1;
-    }
-
-    A = alloc_matrix(M, K);
-    B = alloc_matrix(K, N);
-    C = alloc_matrix(M, N);
-    if (!A || !B || !C) { fprintf(stderr, "Allocation failed\n"); return 1; }
-
-    printf("Enter A (%d x %d) row-wise:\n", M, K);
-    for (int i = 0; i < M; i++)
-        for (int j = 0; j < K; j++)
-            scanf("%d", &A[i][j]);
-
-    printf("Enter B (%d x %d) row-wise:\n", K, N);
-    for (int i = 0; i < K; i++)
-        for (int j = 0; j < N; j++)
-            scanf("%d", &B[i][j]);
-
+int multiply_cells(void) {
     pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * M * N);
-    if (!threads) { fprintf(stderr, "Thread array alloc failed\n"); return 1; }
+    if (!threads) { fprintf(stderr, "Thread array alloc failed\n"); return -1; }
 
     int t = 0;
     for (int i = 0; i < M; i++) {
         for (int j = 0; j < N; j++) {
             Cell *cell = (Cell*)malloc(sizeof(Cell));
-            if (!cell) { fprintf(stderr, "Arg alloc failed\n"); return 1; }
+            if (!cell) { fprintf(stderr, "Arg alloc failed\n"); return -1; }
             cell->i = i; cell->j = j;
             int rc = pthread_create(&threads[t++], NULL, worker, cell);
-            if (rc != 0) { fprintf(stderr, "pthread_create failed (%d)\n", rc); return 1; }
+            if (rc != 0) { fprintf(stderr, "pthread_create failed (%d)\n", rc); return -1; }
         }
     }
     for (int i = 0; i < t; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    return 0;
+}
 
-    printf("Result matrix C = A x B:\n");
-    for (int i = 0; i < M; i++) {
-        for (int j = 0; j < N; j++)
-            printf("%d%c", C[i][j], (j+1==N)?'\n':' ');
+/* Micro-kernels. Each one adds an MR x NR block of products into the 64-bit tile
+   accumulator: c[r*NB + j] += sum_p a[r*lda + p] * b[p*NB + j]. Inputs are sign-extended
+   to 64-bit lanes and multiplied with the signed 32x32->64 multiply (pmuldq), so the sums
+   are exactly those of the scalar loop. The accumulator wraps mod 2^64: Strassen feeds in
+   wrapped operands whose products are near 2^62, so rows_scalar adds in uint64_t rather
+   than overflowing a signed sum. It is the portable fallback and also handles rows left
+   over below a multiple of MR. */
+typedef void (*MicroKernel)(int kb, const int *a, int lda, const int *b, uint64_t *c);
+
+typedef struct {
+    const char *name;
+    MicroKernel fn;     // NULL: scalar rows only
+    int mr, nr;
+    int (*supported)(void);
+} KernelInfo;
+
+static void rows_scalar(int rows, int kb, const int *a, int lda, const int *b, uint64_t *c) {
+    for (int i = 0; i < rows; i++) {
+        uint64_t *ci = c + (size_t)i * NB;
+        for (int p = 0; p < kb; p++) {
+            uint64_t av = (uint64_t)(int64_t)a[(size_t)i * lda + p];   // sign-extend, as pmuldq
+            const int *bp = b + (size_t)p * NB;
+            for (int j = 0; j < NB; j++) ci[j] += av * (uint64_t)(int64_t)bp[j];
+        }
     }
+}
 
-    free(threads);
-    free_matrix(A); free_matrix(B); free_matrix(C);
+static int always(void) { return 1; }
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse4.1")))
+static void kernel_sse41(int kb, const int *a, int lda, const int *b, uint64_t *c) {
+    __m128i acc[4][2];
+    for (int r = 0; r < 4; r++) acc[r][0] = acc[r][1] = _mm_setzero_si128();
+    for (int p = 0; p < kb; p++) {
+        const int *bp = b + (size_t)p * NB;
+        __m128i b0 = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i*)bp));
+        __m128i b1 = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i*)(bp + 2)));
+#pragma GCC unroll 4
+        for (int r = 0; r < 4; r++) {
+            __m128i av = _mm_set1_epi64x(a[(size_t)r * lda + p]);
+            acc[r][0] = _mm_add_epi64(acc[r][0], _mm_mul_epi32(av, b0));
+            acc[r][1] = _mm_add_epi64(acc[r][1], _mm_mul_epi32(av, b1));
+        }
+    }
+    for (int r = 0; r < 4; r++)
+        for (int h = 0; h < 2; h++) {
+            __m128i *cp = (__m128i*)(c + (size_t)r * NB + 2 * h);
+            _mm_storeu_si128(cp, _mm_add_epi64(_mm_loadu_si128(cp), acc[r][h]));
+        }
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2(int kb, const int *a, int lda, const int *b, uint64_t *c) {
+    __m256i acc[4][2];
+    for (int r = 0; r < 4; r++) acc[r][0] = acc[r][1] = _mm256_setzero_si256();
+    for (int p = 0; p < kb; p++) {
+        const int *bp = b + (size_t)p * NB;
+        __m256i b0 = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)bp));
+        __m256i b1 = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(bp + 4)));
+#pragma GCC unroll 4
+        for (int r = 0; r < 4; r++) {
+            __m256i av = _mm256_set1_epi64x(a[(size_t)r * lda + p]);
+            acc[r][0] = _mm256_add_epi64(acc[r][0], _mm256_mul_epi32(av, b0));
+            acc[r][1] = _mm256_add_epi64(acc[r][1], _mm256_mul_epi32(av, b1));
+        }
+    }
+    for (int r = 0; r < 4; r++)
+        for (int h = 0; h < 2; h++) {
+            __m256i *cp = (__m256i*)(c + (size_t)r * NB + 4 * h);
+            _mm256_storeu_si256(cp, _mm256_add_epi64(_mm256_loadu_si256(cp), acc[r][h]));
+        }
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512(int kb, const int *a, int lda, const int *b, uint64_t *c) {
+    __m512i acc[8][2];
+    for (int r = 0; r < 8; r++) acc[r][0] = acc[r][1] = _mm512_setzero_si512();
+    for (int p = 0; p < kb; p++) {
+        const int *bp = b + (size_t)p * NB;
+        __m512i b0 = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)bp));
+        __m512i b1 = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(bp + 8)));
+#pragma GCC unroll 8
+        for (int r = 0; r < 8; r++) {
+            __m512i av = _mm512_set1_epi64(a[(size_t)r * lda + p]);
+            acc[r][0] = _mm512_add_epi64(acc[r][0], _mm512_mul_epi32(av, b0));
+            acc[r][1] = _mm512_add_epi64(acc[r][1], _mm512_mul_epi32(av, b1));
+        }
+    }
+    for (int r = 0; r < 8; r++)
+        for (int h = 0; h < 2; h++) {
+            uint64_t *cp = c + (size_t)r * NB + 8 * h;
+            _mm512_storeu_si512(cp, _mm512_add_epi64(_mm512_loadu_si512(cp), acc[r][h]));
+        }
+}
+
+static int has_sse41(void) { __builtin_cpu_init(); return __builtin_cpu_supports("sse4.1"); }
+static int has_avx2(void) { __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }
+static int has_avx512(void) { __builtin_cpu_init(); return __builtin_cpu_supports("avx512f"); }
+#endif
+
+// Best first; select_kernel picks the first one the CPU supports.
+static const KernelInfo kernels[] = {
+#ifdef HAVE_X86_KERNELS
+    { "avx512", kernel_avx512, 8, 16, has_avx512 },
+    { "avx2",   kernel_avx2,   4, 8,  has_avx2 },
+    { "sse4.1", kernel_sse41,  4, 4,  has_sse41 },
+#endif
+    { "scalar", NULL,          1, NB, always },
+};
+#define NUM_KERNELS ((int)(sizeof kernels / sizeof kernels[0]))
+
+static const KernelInfo *kern = &kernels[NUM_KERNELS - 1];
+
+// name == NULL: best supported. Returns 0 if the named kernel is unknown or unsupported.
+int select_kernel(const char *name) {
+    for (int i = 0; i < NUM_KERNELS; i++)
+        if ((!name || strcmp(name, kernels[i].name) == 0) && kernels[i].supported()) {
+            kern = &kernels[i];
+            return 1;
+        }
+    return 0;
+}
+
+/* Tiled mode. B is first packed into column panels so the inner loop reads it with unit
+   stride; then each task computes one MB x NB tile of C, walking K in KB-deep slices so the
+   panel slice stays in cache, with the selected micro-kernel. Sums are kept in 64 bits and
+   truncated once, as in worker(). The operands may be blocks inside larger matrices (lda,
+   ldb, ldc are row strides), which the recursive and Strassen modes use for their leaves. */
+typedef struct {
+    const int *a, *b;
+    int *c;
+    int lda, ldb, ldc, m, k, n;
+    int accumulate;         // C += A*B instead of C = A*B
+    int *bp;                // B packed into NB-wide column panels, each k x NB row-major
+} Gemm;
+
+static void pack_task(void *ctx, int jb) {
+    Gemm *g = (Gemm*)ctx;
+    int *panel = g->bp + (size_t)jb * g->k * NB;
+    int j0 = jb * NB, nb = g->n - j0 < NB ? g->n - j0 : NB;
+    for (int p = 0; p < g->k; p++) {
+        memcpy(panel + (size_t)p * NB, g->b + (size_t)p * g->ldb + j0, sizeof(int) * nb);
+        memset(panel + (size_t)p * NB + nb, 0, sizeof(int) * (NB - nb));
+    }
+}
+
+static void tile_task(void *ctx, int t) {
+    Gemm *g = (Gemm*)ctx;
+    int ntn = (g->n + NB - 1) / NB;
+    int i0 = t / ntn * MB, j0 = t % ntn * NB;
+    int mb = g->m - i0 < MB ? g->m - i0 : MB, nb = g->n - j0 < NB ? g->n - j0 : NB;
+    const int *panel = g->bp + (size_t)(t % ntn) * g->k * NB;
+    const int *a = g->a + (size_t)i0 * g->lda;
+    uint64_t acc[MB][NB];
+    memset(acc, 0, sizeof(acc[0]) * mb);
+    int full = kern->fn ? mb / kern->mr * kern->mr : 0;
+    for (int k0 = 0; k0 < g->k; k0 += KB) {
+        int kb = g->k - k0 < KB ? g->k - k0 : KB;
+        const int *b = panel + (size_t)k0 * NB;
+        for (int i = 0; i < full; i += kern->mr)
+            for (int j = 0; j < NB; j += kern->nr)
+                kern->fn(kb, a + (size_t)i * g->lda + k0, g->lda, b + j, acc[i] + j);
+        if (full < mb) rows_scalar(mb - full, kb, a + (size_t)full * g->lda + k0, g->lda, b, acc[full]);
+    }
+    for (int i = 0; i < mb; i++) {
+        int *c = g->c + (size_t)(i0 + i) * g->ldc + j0;
+        for (int j = 0; j < nb; j++)
+            c[j] = (int)(g->accumulate ? (uint32_t)c[j] + (uint32_t)acc[i][j] : (uint32_t)acc[i][j]);
+    }
+}
+
+// pool == NULL runs the tasks on the calling thread.
+static void run_tasks(Pool *pool, int ntasks, void (*fn)(void*, int), void *ctx) {
+    if (pool) pool_run(pool, ntasks, fn, ctx);
+    else for (int t = 0; t < ntasks; t++) fn(ctx, t);
+}
+
+static int gemm(Pool *pool, Gemm *g) {
+    int ntn = (g->n + NB - 1) / NB, ntm = (g->m + MB - 1) / MB;
+    g->bp = (int*)malloc(sizeof(int) * (size_t)g->k * NB * ntn);
+    if (!g->bp) { fprintf(stderr, "Allocation failed\n"); return -1; }
+    run_tasks(pool, ntn, pack_task, g);
+    run_tasks(pool, ntm * ntn, tile_task, g);
+    free(g->bp);
+    g->bp = NULL;
+    return 0;
+}
+
+int multiply_tiled(Pool *pool) {
+    Gemm g = { A[0], B[0], C[0], K, N, N, M, K, N, 0, NULL };
+    return gemm(pool, &g);
+}
+
+/* Recursive (cache-oblivious) mode: halve the largest of m, k, n until a block is at most
+   REC_LEAF^3, so every level of the cache hierarchy eventually holds a working set without
+   knowing its size. Splitting k makes both halves add into the same C block, which is safe
+   because the tiled leaves accumulate with wrapping 32-bit adds: the truncated result is the
+   same as truncating the full 64-bit sum. The top levels split only m and n, giving
+   independent blocks that run as pool tasks. */
+typedef struct { const int *a, *b; int *c; int m, k, n; } RecBlock;
+
+static struct {
+    int lda, ldb, ldc;
+    RecBlock *blocks;
+    int nblocks;
+} rec;
+
+static void rec_mul(const int *a, const int *b, int *c, int m, int k, int n) {
+    if ((long long)m * k * n <= (long long)REC_LEAF * REC_LEAF * REC_LEAF) {
+        Gemm g = { a, b, c, rec.lda, rec.ldb, rec.ldc, m, k, n, 1, NULL };
+        gemm(NULL, &g);
+        return;
+    }
+    if (m >= k && m >= n) {
+        int h = m / 2;
+        rec_mul(a, b, c, h, k, n);
+        rec_mul(a + (size_t)h * rec.lda, b, c + (size_t)h * rec.ldc, m - h, k, n);
+    } else if (n >= k) {
+        int h = n / 2;
+        rec_mul(a, b, c, m, k, h);
+        rec_mul(a, b + h, c + h, m, k, n - h);
+    } else {
+        int h = k / 2;
+        rec_mul(a, b, c, m, h, n);
+        rec_mul(a + h, b + (size_t)h * rec.ldb, c, m, k - h, n);
+    }
+}
+
+static void rec_split(RecBlock blk, int depth) {
+    if (depth == 0 || (blk.m < 2 && blk.n < 2)) { rec.blocks[rec.nblocks++] = blk; return; }
+    RecBlock lo = blk, hi = blk;
+    if (blk.m >= blk.n) {
+        lo.m = blk.m / 2; hi.m = blk.m - lo.m;
+        hi.a += (size_t)lo.m * rec.lda; hi.c += (size_t)lo.m * rec.ldc;
+    } else {
+        lo.n = blk.n / 2; hi.n = blk.n - lo.n;
+        hi.b += lo.n; hi.c += lo.n;
+    }
+    rec_split(lo, depth - 1);
+    rec_split(hi, depth - 1);
+}
+
+static void rec_task(void *ctx, int t) {
+    (void)ctx;
+    RecBlock *blk = &rec.blocks[t];
+    rec_mul(blk->a, blk->b, blk->c, blk->m, blk->k, blk->n);
+}
+
+int multiply_recursive(Pool *pool) {
+    int depth = 0;
+    while ((1 << depth) < 4 * (pool->nthreads + 1)) depth++;   // a few blocks per thread
+    rec.lda = K; rec.ldb = N; rec.ldc = N;
+    rec.blocks = (RecBlock*)malloc(sizeof(RecBlock) << depth);
+    rec.nblocks = 0;
+    if (!rec.blocks) { fprintf(stderr, "Allocation failed\n"); return -1; }
+    memset(C[0], 0, sizeof(int) * M * N);
+    rec_split((RecBlock){ A[0], B[0], C[0], M, K, N }, depth);
+    pool_run(pool, rec.nblocks, rec_task, NULL);
+    free(rec.blocks);
+    return 0;
+}
+
+/* Strassen-Winograd mode: 7 half-size products and 15 additions per level instead of 8
+   products, down to `cutoff`, where the tiled kernel takes over. All arithmetic wraps mod
+   2^32, which gives exactly the truncated 64-bit sums of the other modes. The operands are
+   zero-padded to a square of size cutoff-or-less times a power of two. The products of the
+   top one or two levels (7 or 49) run as pool tasks, each recursing serially. */
+typedef struct {
+    int h;
+    int *buf;               // 15 h x h blocks
+    int *S[4], *T[4], *P[7];
+    int *c;                 // where the combined result goes
+    int ldc;
+} Wino;
+
+// d = x + y, or x - y when sub is set (wrapping).
+static void mat_addsub(int *d, int ldd, const int *x, int ldx, const int *y, int ldy, int h, int sub) {
+    for (int i = 0; i < h; i++)
+        for (int j = 0; j < h; j++) {
+            unsigned xv = (unsigned)x[(size_t)i * ldx + j], yv = (unsigned)y[(size_t)i * ldy + j];
+            d[(size_t)i * ldd + j] = (int)(sub ? xv - yv : xv + yv);
+        }
+}
+
+static int wino_prepare(Wino *w, const int *a, int lda, const int *b, int ldb, int h, int *c, int ldc) {
+    size_t blk = (size_t)h * h;
+    w->h = h;
+    w->c = c;
+    w->ldc = ldc;
+    w->buf = (int*)malloc(sizeof(int) * 15 * blk);
+    if (!w->buf) return -1;
+    for (int i = 0; i < 4; i++) { w->S[i] = w->buf + i * blk; w->T[i] = w->buf + (4 + i) * blk; }
+    for (int i = 0; i < 7; i++) w->P[i] = w->buf + (8 + i) * blk;
+    const int *a11 = a, *a12 = a + h, *a21 = a + (size_t)h * lda, *a22 = a21 + h;
+    const int *b11 = b, *b12 = b + h, *b21 = b + (size_t)h * ldb, *b22 = b21 + h;
+    mat_addsub(w->S[0], h, a21, lda, a22, lda, h, 0);       // S1 = A21 + A22
+    mat_addsub(w->S[1], h, w->S[0], h, a11, lda, h, 1);     // S2 = S1 - A11
+    mat_addsub(w->S[2], h, a11, lda, a21, lda, h, 1);       // S3 = A11 - A21
+    mat_addsub(w->S[3], h, a12, lda, w->S[1], h, h, 1);     // S4 = A12 - S2
+    mat_addsub(w->T[0], h, b12, ldb, b11, ldb, h, 1);       // T1 = B12 - B11
+    mat_addsub(w->T[1], h, b22, ldb, w->T[0], h, h, 1);     // T2 = B22 - T1
+    mat_addsub(w->T[2], h, b22, ldb, b12, ldb, h, 1);       // T3 = B22 - B12
+    mat_addsub(w->T[3], h, w->T[1], h, b21, ldb, h, 1);     // T4 = T2 - B21
+    return 0;
+}
+
+// Operands of product i: P1 = A11 B11, P2 = A12 B21, P3 = S4 B22, P4 = A22 T4,
+// P5 = S1 T1, P6 = S2 T2, P7 = S3 T3.
+static void wino_operands(const Wino *w, int i, const int *a, int lda, const int *b, int ldb,
+                          const int **x, int *ldx, const int **y, int *ldy) {
+    int h = w->h;
+    const int *xs[7] = { a, a + h, w->S[3], a + (size_t)h * lda + h, w->S[0], w->S[1], w->S[2] };
+    const int *ys[7] = { b, b + (size_t)h * ldb, b + (size_t)h * ldb + h, w->T[3], w->T[0], w->T[1], w->T[2] };
+    int xl[7] = { lda, lda, h, lda, h, h, h }, yl[7] = { ldb, ldb, ldb, h, h, h, h };
+    *x = xs[i]; *ldx = xl[i];
+    *y = ys[i]; *ldy = yl[i];
+}
+
+static void wino_combine(Wino *w) {
+    int h = w->h, ldc = w->ldc;
+    int *c11 = w->c, *c12 = w->c + h, *c21 = w->c + (size_t)h * ldc, *c22 = c21 + h;
+    int **P = w->P;
+    mat_addsub(c11, ldc, P[0], h, P[1], h, h, 0);   // C11 = P1 + P2
+    mat_addsub(P[5], h, P[0], h, P[5], h, h, 0);    // U2 = P1 + P6
+    mat_addsub(P[6], h, P[5], h, P[6], h, h, 0);    // U3 = U2 + P7
+    mat_addsub(P[5], h, P[5], h, P[4], h, h, 0);    // U4 = U2 + P5
+    mat_addsub(c12, ldc, P[5], h, P[2], h, h, 0);   // C12 = U4 + P3
+    mat_addsub(c21, ldc, P[6], h, P[3], h, h, 1);   // C21 = U3 - P4
+    mat_addsub(c22, ldc, P[6], h, P[4], h, h, 0);   // C22 = U3 + P5
+    free(w->buf);
+}
+
+static int strassen_cutoff = STRASSEN_CUTOFF;
+
+static int strassen_rec(const int *a, int lda, const int *b, int ldb, int *c, int ldc, int n) {
+    if (n <= strassen_cutoff || n % 2) {
+        Gemm g = { a, b, c, lda, ldb, ldc, n, n, n, 0, NULL };
+        return gemm(NULL, &g);
+    }
+    Wino w;
+    if (wino_prepare(&w, a, lda, b, ldb, n / 2, c, ldc) != 0) return -1;
+    for (int i = 0; i < 7; i++) {
+        const int *x, *y;
+        int ldx, ldy;
+        wino_operands(&w, i, a, lda, b, ldb, &x, &ldx, &y, &ldy);
+        if (strassen_rec(x, ldx, y, ldy, w.P[i], w.h, w.h) != 0) { free(w.buf); return -1; }
+    }
+    wino_combine(&w);
     return 0;
-}
\ No newline at end of file
+}
+
+typedef struct { const int *a, *b; int *c; int lda, ldb, ldc, n; } MulTask;
+
+static struct {
+    Wino nodes[8];          // expanded levels, parents before children
+    int nnodes;
+    MulTask leaves[49];
+    int nleaves;
+    _Atomic int failed;
+} sw;
+
+static int sw_expand(const int *a, int lda, const int *b, int ldb, int *c, int ldc, int n, int levels) {
+    if (levels == 0 || n <= strassen_cutoff || n % 2) {
+        sw.leaves[sw.nleaves++] = (MulTask){ a, b, c, lda, ldb, ldc, n };
+        return 0;
+    }
+    Wino *w = &sw.nodes[sw.nnodes++];
+    if (wino_prepare(w, a, lda, b, ldb, n / 2, c, ldc) != 0) return -1;
+    for (int i = 0; i < 7; i++) {
+        const int *x, *y;
+        int ldx, ldy;
+        wino_operands(w, i, a, lda, b, ldb, &x, &ldx, &y, &ldy);
+        if (sw_expand(x, ldx, y, ldy, w->P[i], w->h, w->h, levels - 1) != 0) return -1;
+    }
+    return 0;
+}
+
+static void sw_task(void *ctx, int t) {
+    (void)ctx;
+    MulTask *m = &sw.leaves[t];
+    if (strassen_rec(m->a, m->lda, m->b, m->ldb, m->c, m->ldc, m->n) != 0) atomic_store(&sw.failed, 1);
+}
+
+int multiply_strassen(Pool *pool) {
+    int size = M > K ? M : K, levels = 0;
+    if (N > size) size = N;
+    while (size > strassen_cutoff) { size = (size + 1) / 2; levels++; }
+    int n = size << levels;
+    int *a = (int*)calloc((size_t)n * n, sizeof(int));
+    int *b = (int*)calloc((size_t)n * n, sizeof(int));
+    int *c = (int*)malloc(sizeof(int) * (size_t)n * n);
+    if (!a || !b || !c) { fprintf(stderr, "Allocation failed\n"); free(a); free(b); free(c); return -1; }
+    for (int i = 0; i < M; i++) memcpy(a + (size_t)i * n, A[i], sizeof(int) * K);
+    for (int i = 0; i < K; i++) memcpy(b + (size_t)i * n, B[i], sizeof(int) * N);
+
+    int par = pool->nthreads == 0 ? 0 : pool->nthreads < 7 ? 1 : 2;
+    sw.nnodes = sw.nleaves = 0;
+    atomic_store(&sw.failed, 0);
+    int rc = sw_expand(a, n, b, n, c, n, n, par);
+    if (rc == 0) pool_run(pool, sw.nleaves, sw_task, NULL);
+    if (rc == 0 && atomic_load(&sw.failed)) rc = -1;
+    for (int i = sw.nnodes - 1; i >= 0; i--) {
+        if (rc == 0) wino_combine(&sw.nodes[i]);
+        else free(sw.nodes[i].buf);
+    }
+    if (rc == 0)
+        for (int i = 0; i < M; i++) memcpy(C[i], c + (size_t)i * n, sizeof(int) * N);
+    else fprintf(stderr, "Allocation failed\n");
+    free(a); free(b); free(c);
+    return rc;
+}
+
+/* Sparse modes. An operand is converted to CSR (row pointers, column indices, values) and
+   C is computed row by row: each non-zero A[i][p] adds A[i][p] * row p of B into a 64-bit row
+   accumulator, so results are the same truncated sums as the dense modes. With B dense that
+   row is read in full (`sparse`); with B also in CSR only its non-zeros are (`spgemm`). Rows
+   are split into chunks holding equal numbers of non-zeros, so a few dense rows do not leave
+   one thread with most of the work. `auto` measures the density of A and B and picks. */
+typedef struct {
+    int rows, cols;
+    long *rowptr;           // rows + 1 entries
+    int *col, *val;
+} Csr;
+
+static struct {
+    int **m;
+    int rows, cols, nchunks;
+    Csr *out;
+} csr_build;
+
+static void csr_count_task(void *ctx, int t) {
+    (void)ctx;
+    int r0 = (int)((long)csr_build.rows * t / csr_build.nchunks);
+    int r1 = (int)((long)csr_build.rows * (t + 1) / csr_build.nchunks);
+    for (int i = r0; i < r1; i++) {
+        long nz = 0;
+        for (int j = 0; j < csr_build.cols; j++) nz += csr_build.m[i][j] != 0;
+        csr_build.out->rowptr[i + 1] = nz;
+    }
+}
+
+static void csr_fill_task(void *ctx, int t) {
+    (void)ctx;
+    Csr *c = csr_build.out;
+    int r0 = (int)((long)csr_build.rows * t / csr_build.nchunks);
+    int r1 = (int)((long)csr_build.rows * (t + 1) / csr_build.nchunks);
+    for (int i = r0; i < r1; i++) {
+        long q = c->rowptr[i];
+        for (int j = 0; j < csr_build.cols; j++)
+            if (csr_build.m[i][j]) { c->col[q] = j; c->val[q++] = csr_build.m[i][j]; }
+    }
+}
+
+int csr_from_dense(Pool *pool, int **m, int rows, int cols, Csr *c) {
+    c->rows = rows;
+    c->cols = cols;
+    c->rowptr = (long*)malloc(sizeof(long) * (rows + 1));
+    c->col = c->val = NULL;
+    if (!c->rowptr) return -1;
+    c->rowptr[0] = 0;
+    csr_build.m = m;
+    csr_build.rows = rows;
+    csr_build.cols = cols;
+    csr_build.nchunks = (pool->nthreads + 1) * CHUNKS_PER_THREAD;
+    csr_build.out = c;
+    pool_run(pool, csr_build.nchunks, csr_count_task, NULL);
+    for (int i = 0; i < rows; i++) c->rowptr[i + 1] += c->rowptr[i];
+    long nnz = c->rowptr[rows];
+    c->col = (int*)malloc(sizeof(int) * (nnz ? nnz : 1));
+    c->val = (int*)malloc(sizeof(int) * (nnz ? nnz : 1));
+    if (!c->col || !c->val) return -1;
+    pool_run(pool, csr_build.nchunks, csr_fill_task, NULL);
+    return 0;
+}
+
+void csr_free(Csr *c) {
+    free(c->rowptr);
+    free(c->col);
+    free(c->val);
+}
+
+// Fraction of non-zero entries, sampled on up to 64 evenly spaced rows.
+double density(int **m, int rows, int cols) {
+    int step = rows > 64 ? rows / 64 : 1;
+    long nz = 0, seen = 0;
+    for (int i = 0; i < rows; i += step, seen += cols)
+        for (int j = 0; j < cols; j++) nz += m[i][j] != 0;
+    return (double)nz / seen;
+}
+
+static struct {
+    Csr a, b;
+    int use_b;              // B in CSR (spgemm) rather than dense
+    int *start;             // nchunks + 1 row boundaries
+} sp;
+
+static void sparse_task(void *ctx, int t) {
+    (void)ctx;
+    long long *acc = (long long*)malloc(sizeof(long long) * N);
+    if (!acc) { fprintf(stderr, "Allocation failed\n"); exit(1); }
+    for (int i = sp.start[t]; i < sp.start[t + 1]; i++) {
+        memset(acc, 0, sizeof(long long) * N);
+        for (long q = sp.a.rowptr[i]; q < sp.a.rowptr[i + 1]; q++) {
+            long long v = sp.a.val[q];
+            int p = sp.a.col[q];
+            if (sp.use_b) {
+                for (long r = sp.b.rowptr[p]; r < sp.b.rowptr[p + 1]; r++) acc[sp.b.col[r]] += v * sp.b.val[r];
+            } else {
+                const int *b = B[p];
+                for (int j = 0; j < N; j++) acc[j] += v * b[j];
+            }
+        }
+        for (int j = 0; j < N; j++) C[i][j] = (int)acc[j];
+    }
+    free(acc);
+}
+
+static int multiply_csr(Pool *pool, int use_b) {
+    int nchunks = (pool->nthreads + 1) * CHUNKS_PER_THREAD, rc = -1;
+    memset(&sp, 0, sizeof sp);
+    sp.use_b = use_b;
+    sp.start = (int*)malloc(sizeof(int) * (nchunks + 1));
+    if (!sp.start || csr_from_dense(pool, A, M, K, &sp.a) != 0 ||
+        (use_b && csr_from_dense(pool, B, K, N, &sp.b) != 0)) {
+        fprintf(stderr, "Allocation failed\n");
+        goto out;
+    }
+    // Chunk t starts at the first row whose non-zeros begin at or after t/nchunks of the total.
+    long nnz = sp.a.rowptr[M];
+    for (int t = 0, i = 0; t <= nchunks; t++) {
+        long target = nnz * t / nchunks;
+        while (i < M && sp.a.rowptr[i] < target) i++;
+        sp.start[t] = t == nchunks ? M : i;
+    }
+    pool_run(pool, nchunks, sparse_task, NULL);
+    rc = 0;
+out:
+    csr_free(&sp.a);
+    csr_free(&sp.b);
+    free(sp.start);
+    return rc;
+}
+
+int multiply_sparse(Pool *pool) { return multiply_csr(pool, 0); }
+int multiply_spgemm(Pool *pool) { return multiply_csr(pool, 1); }
+
+int multiply_auto(Pool *pool) {
+    double da = density(A, M, K);
+    if (da < SPGEMM_DENSITY && density(B, K, N) < SPGEMM_DENSITY) return multiply_csr(pool, 1);
+    return da < SPARSE_DENSITY ? multiply_csr(pool, 0) : multiply_tiled(pool);
+}
+
+/* Binary matrix files: a MatHeader, then rows x cols int32 in row-major order (native byte
+   order) starting at `offset`. Inputs are mapped with mmap and used in place as the operand
+   buffers; results are written with a single writev of header and payload. */
+#define MAT_MAGIC "IMAT"
+#define MAT_INT32 1
+#define MAT_OFFSET 64       // payload offset, keeps rows cache-line aligned
+
+typedef struct {
+    char magic[4];
+    uint32_t dtype;
+    uint32_t rows, cols;
+    uint64_t offset;
+} MatHeader;
+
+typedef struct { void *base; size_t len; } Mapping;
+
+// Map a matrix file; returns row pointers into the mapping (free with unmap_matrix).
+int** map_matrix(const char *path, int *rows, int *cols, Mapping *map) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return NULL; }
+    struct stat st;
+    MatHeader h;
+    if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof h, 0) != (ssize_t)sizeof h ||
+        memcmp(h.magic, MAT_MAGIC, 4) != 0 || h.dtype != MAT_INT32 || h.rows == 0 || h.cols == 0 ||
+        h.rows > INT32_MAX || h.cols > INT32_MAX || h.offset % sizeof(int) ||
+        h.offset < sizeof h || h.offset > (uint64_t)st.st_size ||   // divide, so the size cannot wrap
+        h.rows > ((uint64_t)st.st_size - h.offset) / sizeof(int) / h.cols) {
+        fprintf(stderr, "%s: not an int32 matrix file\n", path);
+        close(fd);
+        return NULL;
+    }
+    // Private and writable so the buffer can be used as int*; pages are only read.
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { perror(path); return NULL; }
+    madvise(base, (size_t)st.st_size, MADV_WILLNEED);
+    int **m = (int**)malloc(sizeof(int*) * h.rows);
+    if (!m) { munmap(base, (size_t)st.st_size); return NULL; }
+    m[0] = (int*)((char*)base + h.offset);
+    for (uint32_t i = 1; i < h.rows; i++) m[i] = m[0] + (size_t)i * h.cols;
+    *rows = (int)h.rows;
+    *cols = (int)h.cols;
+    map->base = base;
+    map->len = (size_t)st.st_size;
+    return m;
+}
+
+void unmap_matrix(int **m, Mapping *map) {
+    if (map->base) munmap(map->base, map->len);
+    free(m);
+}
+
+static int write_all(int fd, struct iovec *iov, int n) {
+    while (n > 0) {
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        while (n > 0 && (size_t)w >= iov->iov_len) { w -= iov->iov_len; iov++; n--; }
+        if (n > 0) { iov->iov_base = (char*)iov->iov_base + w; iov->iov_len -= w; }
+    }
+    return 0;
+}
+
+int save_matrix(const char *path, int **m, int rows, int cols) {
+    char head[MAT_OFFSET] = { 0 };
+    MatHeader h = { { 'I', 'M', 'A', 'T' }, MAT_INT32, (uint32_t)rows, (uint32_t)cols, MAT_OFFSET };
+    memcpy(head, &h, sizeof h);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { perror(path); return -1; }
+    struct iovec iov[2] = { { head, sizeof head }, { m[0], sizeof(int) * (size_t)rows * cols } };
+    int rc = write_all(fd, iov, 2);
+    if (rc != 0) perror(path);
+    if (close(fd) != 0) rc = -1;
+    return rc;
+}
+
+// Text output formatted into one buffer and written at once.
+int print_matrix(int **m, int rows, int cols) {
+    const char *title = "Result matrix C = A x B:\n";
+    size_t cap = strlen(title) + (size_t)rows * cols * 12 + 1, len = 0;
+    char *out = (char*)malloc(cap);
+    if (!out) return -1;
+    len += sprintf(out, "%s", title);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++) len += sprintf(out + len, "%d%c", m[i][j], j + 1 == cols ? '\n' : ' ');
+    fflush(stdout);
+    struct iovec iov = { out, len };
+    int rc = write_all(STDOUT_FILENO, &iov, 1);
+    free(out);
+    return rc;
+}
+
+static int next_int(char **p, char *end, int *v) {
+    char *q;
+    while (*p < end && (**p == ' ' || **p == '\n' || **p == '\t' || **p == '\r')) (*p)++;
+    if (*p >= end) return 0;
+    long x = strtol(*p, &q, 10);
+    if (q == *p) return 0;
+    *v = (int)x;
+    *p = q;
+    return 1;
+}
+
+/* Converter from the interactive text format ("M K N", then A and B row-wise) to two
+   binary matrix files. */
+int convert_text(const char *text, const char *a_path, const char *b_path) {
+    int rc = 1;
+    char *buf = NULL;
+    size_t len = 0;
+    struct stat st;
+    int fd = open(text, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !(buf = (char*)malloc((size_t)st.st_size + 1))) { perror(text); goto out; }
+    while (len < (size_t)st.st_size) {   // read() may return less than asked
+        ssize_t r = read(fd, buf + len, (size_t)st.st_size - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { perror(text); goto out; }
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+    buf[len] = '\0';
+    char *p = buf, *end = buf + len;
+    if (!next_int(&p, end, &M) || !next_int(&p, end, &K) || !next_int(&p, end, &N) || M <= 0 || K <= 0 || N <= 0) {
+        fprintf(stderr, "%s: invalid sizes\n", text);
+        goto out;
+    }
+    A = alloc_matrix(M, K);
+    B = alloc_matrix(K, N);
+    if (!A || !B) { fprintf(stderr, "Allocation failed\n"); goto out; }
+    for (long i = 0; i < (long)M * K; i++)
+        if (!next_int(&p, end, &A[0][i])) { fprintf(stderr, "%s: A is short\n", text); goto out; }
+    for (long i = 0; i < (long)K * N; i++)
+        if (!next_int(&p, end, &B[0][i])) { fprintf(stderr, "%s: B is short\n", text); goto out; }
+    rc = save_matrix(a_path, A, M, K) || save_matrix(b_path, B, K, N);
+    if (rc == 0) printf("Wrote %s (%d x %d) and %s (%d x %d)\n", a_path, M, K, b_path, K, N);
+out:
+    if (fd >= 0) close(fd);
+    free(buf);
+    free_matrix(A); free_matrix(B);
+    A = B = NULL;
+    return rc;
+}
+
+typedef struct { const char *name; int (*fn)(Pool*); } Mode;
+static const Mode modes[] = {
+    { "tiled", multiply_tiled }, { "recursive", multiply_recursive }, { "strassen", multiply_strassen },
+    { "sparse", multiply_sparse }, { "spgemm", multiply_spgemm }, { "auto", multiply_auto },
+};
+#define NUM_MODES ((int)(sizeof modes / sizeof modes[0]))
+
+static double fill_density = 1.0;   // benchmark operands: fraction of non-zero entries
+
+static int random_value(void) {
+    if (fill_density < 1.0 && rand() >= fill_density * RAND_MAX) return 0;
+    return rand() % 201 - 100;
+}
+
+static int random_operands(int n) {
+    M = K = N = n;
+    A = alloc_matrix(M, K);
+    B = alloc_matrix(K, N);
+    C = alloc_matrix(M, N);
+    if (!A || !B || !C) { fprintf(stderr, "Allocation failed\n"); return -1; }
+    srand(1);
+    for (int i = 0; i < M * K; i++) A[0][i] = random_value();
+    for (int i = 0; i < K * N; i++) B[0][i] = random_value();
+    return 0;
+}
+
+/* Random n x n operands; times the tiled mode with every micro-kernel this CPU supports, the
+   recursive, Strassen, sparse and auto modes and, while M*N is small enough to spawn that many threads,
+   the per-cell mode. Every result must match the first bit for bit; that one is checked
+   against the per-cell mode or, for large n, against a serial dot product on sampled cells. */
+int run_benchmark(int n, int nthreads, const char *only) {
+    if (random_operands(n) != 0) return 1;
+    int **R = alloc_matrix(M, N);
+    if (!R) { fprintf(stderr, "Allocation failed\n"); return 1; }
+    double ops = 2.0 * M * N * K;
+    const KernelInfo *best = kern;
+
+    Pool pool;
+    if (pool_init(&pool, nthreads) != 0) { fprintf(stderr, "Pool init failed\n"); return 1; }
+    printf("%d x %d x %d, %d threads, density %.3f\n", M, K, N, nthreads, density(A, M, K));
+    int ok = 1, runs = 0;
+    for (int k = 0; k < NUM_KERNELS + NUM_MODES - 1; k++) {
+        const Mode *mode = &modes[k < NUM_KERNELS ? 0 : k - NUM_KERNELS + 1];
+        if (k < NUM_KERNELS) {
+            if (!kernels[k].supported() || (only && strcmp(only, kernels[k].name) != 0)) continue;
+            kern = &kernels[k];
+        } else kern = best;
+        double t0 = now_sec();
+        if (mode->fn(&pool) != 0) return 1;
+        double secs = now_sec() - t0;
+        int same = runs++ == 0 || memcmp(R[0], C[0], sizeof(int) * M * N) == 0;
+        printf("%-9s %-7s %10.4f s %10.3f GFLOP/s%s\n", mode->name, kern->name, secs, ops / secs / 1e9,
+               same ? "" : "  MISMATCH");
+        if (runs == 1) memcpy(R[0], C[0], sizeof(int) * M * N);
+        ok &= same;
+    }
+    pool_destroy(&pool);
+
+    if ((long long)M * N <= CELL_BENCH_MAX) {
+        double t0 = now_sec();
+        if (multiply_cells() != 0) return 1;
+        double secs = now_sec() - t0;
+        printf("per-cell          %10.4f s %10.3f GFLOP/s\n", secs, ops / secs / 1e9);
+        ok &= memcmp(R[0], C[0], sizeof(int) * M * N) == 0;
+    } else {
+        printf("per-cell          skipped (M*N > %d threads)\n", CELL_BENCH_MAX);
+        for (int s = 0; s < 64; s++) {
+            int i = rand() % M, j = rand() % N;
+            long long sum = 0;
+            for (int p = 0; p < K; p++) sum += (long long)A[i][p] * B[p][j];
+            ok &= R[i][j] == (int)sum;
+        }
+    }
+    printf("check: %s\n", ok ? "ok" : "MISMATCH");
+    free_matrix(A); free_matrix(B); free_matrix(C); free_matrix(R);
+    return ok ? 0 : 1;
+}
+
+/* Crossover table: effective GFLOP/s (2n^3 / time) of the tiled, recursive and Strassen modes
+   for n = 128, 256, ... up to max_n, with Strassen at several cutoffs. */
+int run_crossover(int max_n, int nthreads) {
+    static const int cutoffs[] = { 64, 128, 256, 512 };
+    Pool pool;
+    if (pool_init(&pool, nthreads) != 0) { fprintf(stderr, "Pool init failed\n"); return 1; }
+    printf("Effective GFLOP/s, %d threads, %s kernel\n", nthreads, kern->name);
+    printf("%6s %9s %9s", "n", "tiled", "recursive");
+    for (int c = 0; c < 4; c++) printf("   sw/%-4d", cutoffs[c]);
+    printf("  best\n");
+    int ok = 1;
+    for (int n = 128; n <= max_n; n *= 2) {
+        if (random_operands(n) != 0) return 1;
+        int **R = alloc_matrix(n, n);
+        double best = 0;
+        char best_name[16] = "";
+        printf("%6d", n);
+        for (int v = 0; v < 2 + 4; v++) {
+            const Mode *mode = &modes[v < 2 ? v : 2];
+            if (v >= 2) strassen_cutoff = cutoffs[v - 2];
+            double t0 = now_sec();
+            if (mode->fn(&pool) != 0) return 1;
+            double gflops = 2.0 * n * n * n / (now_sec() - t0) / 1e9;
+            if (v == 0) memcpy(R[0], C[0], sizeof(int) * n * n);
+            else ok &= memcmp(R[0], C[0], sizeof(int) * n * n) == 0;
+            printf(" %9.2f", gflops);
+            if (gflops > best) {
+                best = gflops;
+                if (v < 2) snprintf(best_name, sizeof best_name, "%s", mode->name);
+                else snprintf(best_name, sizeof best_name, "sw/%d", cutoffs[v - 2]);
+            }
+        }
+        printf("  %s\n", best_name);
+        free_matrix(A); free_matrix(B); free_matrix(C); free_matrix(R);
+    }
+    strassen_cutoff = STRASSEN_CUTOFF;
+    pool_destroy(&pool);
+    printf("check: %s\n", ok ? "ok" : "MISMATCH");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN), bench = 0, crossover = 0, opt;
+    const char *kname = NULL, *mname = "auto";
+    const char *a_path = NULL, *b_path = NULL, *c_path = NULL, *text_path = NULL;
+    const char *usage = "Usage: %s [-m auto|tiled|recursive|strassen|sparse|spgemm|cell] [-t threads] [-k avx512|avx2|sse4.1|scalar]\n"
+                        "          [-c strassen_cutoff] [-B n [-d density]] [-X max_n] [-a A.mat -b B.mat [-o C.mat]] [-x text]\n"
+                        "       -a/-b: read binary matrix files instead of stdin, -o: write C as a binary file\n"
+                        "       -x text: convert a text problem (M K N, A, B) to the files given by -a and -b\n"
+                        "       -k: micro-kernel (default: best the CPU supports)\n"
+                        "       -B n: benchmark n x n random matrices in every mode, -d: fraction of non-zeros (default 1)\n"
+                        "       -m auto: CSR x CSR when A and B are under 20%% non-zeros, CSR x dense when A is under 10%%\n"
+                        "       -X max_n: crossover table of the tiled, recursive and Strassen modes\n";
+    while ((opt = getopt(argc, argv, "m:t:k:c:B:d:X:a:b:o:x:")) != -1) {
+        switch (opt) {
+            case 'a': a_path = optarg; break;
+            case 'b': b_path = optarg; break;
+            case 'o': c_path = optarg; break;
+            case 'x': text_path = optarg; break;
+            case 'k': kname = optarg; break;
+            case 'm': mname = optarg; break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'c': strassen_cutoff = atoi(optarg); break;
+            case 'B': bench = atoi(optarg); break;
+            case 'd': fill_density = atof(optarg); break;
+            case 'X': crossover = atoi(optarg); break;
+            default: fprintf(stderr, usage, argv[0]); return 1;
+        }
+    }
+    const Mode *mode = NULL;
+    for (int i = 0; i < NUM_MODES; i++)
+        if (strcmp(mname, modes[i].name) == 0) mode = &modes[i];
+    if ((!mode && strcmp(mname, "cell") != 0) || strassen_cutoff < 1 || fill_density <= 0 || fill_density > 1) { fprintf(stderr, usage, argv[0]); return 1; }
+    if (nthreads < 1) nthreads = 1;
+    if (!select_kernel(kname)) { fprintf(stderr, "Kernel %s not supported here\n", kname); return 1; }
+    if (bench > 0) return run_benchmark(bench, nthreads, kname);
+    if (crossover > 0) return run_crossover(crossover, nthreads);
+    if (text_path) {
+        if (!a_path || !b_path) { fprintf(stderr, usage, argv[0]); return 1; }
+        return convert_text(text_path, a_path, b_path);
+    }
+    if (!a_path != !b_path) { fprintf(stderr, usage, argv[0]); return 1; }
+
+    Mapping amap = { NULL, 0 }, bmap = { NULL, 0 };
+    if (a_path) {
+        int k2;
+        A = map_matrix(a_path, &M, &K, &amap);
+        B = map_matrix(b_path, &k2, &N, &bmap);
+        if (!A || !B) return 1;
+        if (k2 != K) { fprintf(stderr, "A is %d x %d but B is %d x %d\n", M, K, k2, N); return 1; }
+        C = alloc_matrix(M, N);
+        if (!C) { fprintf(stderr, "Allocation failed\n"); return 1; }
+    } else {
+        printf("Enter M K N: ");
+        if (scanf("%d %d %d", &M, &K, &N) != 3 || M<=0 || K<=0 || N<=0) {
+            fprintf(stderr, "Invalid sizes\n"); return 1;
+        }
+
+        A = alloc_matrix(M, K);
+        B = alloc_matrix(K, N);
+        C = alloc_matrix(M, N);
+        if (!A || !B || !C) { fprintf(stderr, "Allocation failed\n"); return 1; }
+
+        printf("Enter A (%d x %d) row-wise:\n", M, K);
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < K; j++)
+                scanf("%d", &A[i][j]);
+
+        printf("Enter B (%d x %d) row-wise:\n", K, N);
+        for (int i = 0; i < K; i++)
+            for (int j = 0; j < N; j++)
+                scanf("%d", &B[i][j]);
+    }
+
+    if (!mode) {
+        if (multiply_cells() != 0) return 1;
+    } else {
+        Pool pool;
+        if (pool_init(&pool, nthreads) != 0) { fprintf(stderr, "Pool init failed\n"); return 1; }
+        if (mode->fn(&pool) != 0) return 1;
+        pool_destroy(&pool);
+    }
+
+    if (c_path ? save_matrix(c_path, C, M, N) : print_matrix(C, M, N)) return 1;
+
+    if (a_path) { unmap_matrix(A, &amap); unmap_matrix(B, &bmap); }
+    else { free_matrix(A); free_matrix(B); }
+    free_matrix(C);
+    return 0;
+}
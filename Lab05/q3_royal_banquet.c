@@ -6,6 +6,8 @@
 #include <time.h>
 #include <string.h>
 #include <math.h>
+#include <stdatomic.h>
+#include "hist.h"
 
 typedef struct { pthread_mutex_t m; pthread_cond_t c; } condpair_t;
 static int N = 6;
@@ -18,124 +20,154 @@ static time_t start_time;
 
 static int forks_available;
 static pthread_mutex_t M = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t waiter_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t waiter_cv;    // CLOCK_MONOTONIC, initialised in main
 
 static condpair_t *ph_cv;         // per-philosopher condition vars
 static int *waiting;              // 1 if currently queued
 static int *granted;              // waiter granted 2 forks?
-static double *req_time;          // absolute seconds since start when requested
+static long long *req_ns;         // CLOCK_MONOTONIC ns when requested
 
-// simple queue of philosopher ids
-static int *Q; static int qh=0, qt=0, qcap=0;
+// min-heap of waiting ids ordered by key[id] (request time); pos[id] is its slot or -1
+typedef struct { int *h; int *pos; const long long *key; int size; } Heap;
+static Heap wq;                   // waiting philosophers
+static int *prio;                 // 1 once the queued philosopher has waited >= T_priority
 
 static int *eats;
-static double *wait_sum, *wait_max;
+static Hist *waits;               // per philosopher, recorded without a lock, read after the joins
 static int *active;               // 1 if philosopher still participating
 static double *join_at_sec;       // late join time (sec since start)
 static double *leave_at_sec;      // early leave time (sec since start), or negative if not leaving
+static int *prio_grants;          // grants made after the philosopher crossed T_priority
+static long waiter_wakeups, waiter_grants;
+static long long t0_ns;           // monotonic start of the banquet
 
-static double now_sec(void) {
+static long long now_ns(void) {
     struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (double)ts.tv_sec + ts.tv_nsec/1e9;
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-static double since_start(void) {
-    static double t0 = -1;
-    if (t0 < 0) t0 = now_sec();
-    return now_sec() - t0;
+static double since_start(void) { return (now_ns() - t0_ns) / 1e9; }
+
+static struct timespec ns_to_ts(long long ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL) };
+    return ts;
+}
+
+// Jain's fairness index: (sum x)^2 / (n sum x^2); 1 when all x are equal, 1/n when one takes all.
+static double jain(const double *x, int n) {
+    double sum = 0, sq = 0;
+    for (int i = 0; i < n; i++) { sum += x[i]; sq += x[i] * x[i]; }
+    return sq > 0 ? sum * sum / (n * sq) : 1.0;
 }
 
-static void q_init(int cap) { Q = (int*)malloc(sizeof(int)*cap); qcap=cap; qh=qt=0; }
-static int  q_empty(void){ return qh==qt; }
-static void q_push(int v){ Q[qt++ % qcap] = v; }
-static int  q_pop(void)  { return Q[qh++ % qcap]; }
-static int  q_size(void) { return qt-qh; }
-static int  q_peek(int idx){ return Q[(qh+idx)%qcap]; }
-static void q_erase_idx(int idx){
-    int sz = q_size();
-    for (int k=idx; k<sz-1; k++) Q[(qh+k)%qcap]=Q[(qh+k+1)%qcap];
-    qt--;
+static int  h_less(const Heap *q, int a, int b){
+    return q->key[a] < q->key[b] || (q->key[a] == q->key[b] && a < b);
+}
+static void h_set(Heap *q, int i, int v){ q->h[i] = v; q->pos[v] = i; }
+static void h_up(Heap *q, int i){
+    int v = q->h[i];
+    while (i > 0 && h_less(q, v, q->h[(i-1)/2])) { h_set(q, i, q->h[(i-1)/2]); i = (i-1)/2; }
+    h_set(q, i, v);
+}
+static void h_down(Heap *q, int i){
+    int v = q->h[i];
+    for (;;) {
+        int c = 2*i+1;
+        if (c >= q->size) break;
+        if (c+1 < q->size && h_less(q, q->h[c+1], q->h[c])) c++;
+        if (!h_less(q, q->h[c], v)) break;
+        h_set(q, i, q->h[c]); i = c;
+    }
+    h_set(q, i, v);
+}
+static void h_push(Heap *q, int v){ q->h[q->size] = v; q->pos[v] = q->size; h_up(q, q->size++); }
+static void h_remove(Heap *q, int v){
+    int i = q->pos[v];
+    q->pos[v] = -1;
+    if (--q->size == i) return;
+    int w = q->h[q->size];
+    h_set(q, i, w);
+    h_up(q, i); h_down(q, q->pos[w]);
 }
 
 static void msleep(int ms){ struct timespec ts={ms/1000,(ms%1000)*1000000}; nanosleep(&ts,NULL); }
 
+/* Grants are driven by events only: a request or a release signals waiter_cv, and the
+   waiter sleeps with no timeout unless the oldest waiter (the heap top) has yet to reach
+   T_priority, in which case it sleeps exactly until that crossing. */
 static void* waiter_thread(void* arg){
     (void)arg;
+    pthread_mutex_lock(&M);
     while (running) {
-        pthread_mutex_lock(&M);
-        // choose next candidate
-        int chosen = -1;
-        double chosen_wait = -1.0;
-
-        // Check if anyone is waiting long enough for priority
-        int sz = q_size();
-        double now = since_start();
-        for (int i = 0; i < sz; i++) {
-            int pid = q_peek(i);
-            if (!active[pid]) { q_erase_idx(i); sz--; i--; continue; }
-            double w = now - req_time[pid];
-            if (w >= T_priority && forks_available >= 2) {
-                if (w > chosen_wait) { chosen = pid; chosen_wait = w; }
-            }
-        }
-
-        if (chosen == -1 && sz > 0 && forks_available >= 2) {
-            // FIFO if no one crosses T
-            chosen = q_peek(0);
+        waiter_wakeups++;
+        // grant the longest waiters while forks last
+        while (wq.size > 0 && forks_available >= 2) {
+            int pid = wq.h[0];
+            h_remove(&wq, pid);
+            if (!active[pid]) { waiting[pid] = 0; continue; }
+            forks_available -= 2;
+            if (prio[pid]) prio_grants[pid]++;
+            prio[pid] = 0;
+            waiting[pid] = 0;
+            granted[pid] = 1;
+            waiter_grants++;
+            pthread_cond_signal(&ph_cv[pid].c);
         }
 
-        if (chosen != -1 && active[chosen] && forks_available >= 2) {
-            // allocate
-            forks_available -= 2;
-            int sz2 = q_size();
-            for (int i=0;i<sz2;i++) if (q_peek(i)==chosen){ q_erase_idx(i); break; }
-            waiting[chosen] = 0;
-            granted[chosen] = 1;
-            pthread_cond_signal(&ph_cv[chosen].c);
-        } 
-        
-        else {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_nsec += 100 * 1000000; // 100ms
-            if (ts.tv_nsec >= 1000000000L) { ts.tv_sec += 1; ts.tv_nsec -= 1000000000L; }
+        if (wq.size > 0 && !prio[wq.h[0]]) {
+            long long cross = req_ns[wq.h[0]] + (long long)(T_priority * 1e9);
+            if (now_ns() >= cross) {
+                prio[wq.h[0]] = 1;  // served as soon as two forks come back
+                continue;
+            }
+            struct timespec ts = ns_to_ts(cross);
             pthread_cond_timedwait(&waiter_cv, &M, &ts);
+        } else {
+            pthread_cond_wait(&waiter_cv, &M);
         }
-
-        pthread_mutex_unlock(&M);
-
-        if (since_start() >= duration_sec) running = 0;
     }
+    pthread_mutex_unlock(&M);
+    return NULL;
+}
 
-    pthread_mutex_lock(&M);
+// Called after every thread has been joined.
+static void report(void){
+    double *x = (double*)calloc(N, sizeof(double));
+    if (!x) return;
     printf("===== Royal Banquet Report =====\n");
     for (int i=0;i<N;i++) {
-        double avg = (eats[i] ? (wait_sum[i]/eats[i]) : 0.0);
-        printf("Philosopher %d: Ate %d times | Avg Wait: %.2fs | Max Wait: %.2fs\n",
-               i, eats[i], avg, wait_max[i]);
+        const Hist *h = &waits[i];
+        double avg = h->n ? (double)h->sum / h->n / 1e9 : 0.0;
+        printf("Philosopher %d: Ate %d times | Avg Wait: %.2fs | p50: %.3fs | p99: %.3fs | Max Wait: %.2fs\n",
+               i, eats[i], avg, hist_percentile(h, 0.50) / 1e9, hist_percentile(h, 0.99) / 1e9, h->max / 1e9);
+        x[i] = eats[i];
     }
-    pthread_mutex_unlock(&M);
-    return NULL;
+    double jm = jain(x, N);
+    for (int i=0;i<N;i++) x[i] = waits[i].n ? (double)waits[i].sum / waits[i].n : 0.0;
+    printf("Jain's fairness index: meals %.4f | mean wait %.4f\n", jm, jain(x, N));
+    long pg = 0;
+    for (int i=0;i<N;i++) pg += prio_grants[i];
+    printf("Waiter: %ld grants (%ld after waiting >= %.2fs) in %ld wakeups\n",
+           waiter_grants, pg, T_priority, waiter_wakeups);
+    free(x);
 }
 
 static void request_to_eat(int id){
     pthread_mutex_lock(&M);
     if (!waiting[id]) {
         waiting[id] = 1;
-        req_time[id] = since_start();
-        q_push(id);
+        req_ns[id] = now_ns();
+        h_push(&wq, id);
         pthread_cond_signal(&waiter_cv);
     }
     while (!granted[id] && active[id] && running)
         pthread_cond_wait(&ph_cv[id].c, &M);
-    double w = since_start() - req_time[id];
+    int ok = granted[id];
+    long long w = now_ns() - req_ns[id];
     granted[id] = 0; // consume grant
     pthread_mutex_unlock(&M);
 
-    // record waiting time
-    if (w < 0) w = 0;
-    if (w > wait_max[id]) wait_max[id] = w;
-    wait_sum[id] += w;
+    if (ok) hist_add(&waits[id], w);  // own histogram, no lock
 }
 
 static void release_forks(void){
@@ -179,7 +211,291 @@ static void* philosopher(void* arg){
     return NULL;
 }
 
+/* Sharded arbiter, for thousands of diners. Diner d belongs to shard d % S; each shard owns
+   a slice of the forks, a request-time heap and a lock, and grants are made by whichever
+   thread holds that lock, so there is no waiter thread to hand off to. Forks move between
+   shards in batches: a shard with free forks and nobody waiting hands all of them to a
+   shard whose waiters are short of forks, and while such a shard owns less than its fair
+   share F/S, a shard owning REBAL_BATCH more than that saves returned forks and sends them
+   over REBAL_BATCH at a time. The T_priority bound holds across shards: a diner
+   whose wait reaches T (a timed wait on its own condvar) marks its shard urgent and collects
+   the free forks of the other shards, and while any shard is urgent every other shard gives
+   returned forks to it instead of granting them locally. */
+#define BENCH_EAT_NS 2000          // busy time holding the forks
+#define REBAL_BATCH 4              // forks moved per rebalancing transfer
+#define BENCH_STACK (64*1024)
+
+typedef struct {
+    pthread_cond_t cv;
+    int shard, granted, prio;
+    long grants;
+    long long max_wait;            // ns
+} __attribute__((aligned(64))) Diner;
+
+typedef struct {
+    pthread_mutex_t m;
+    Heap q;
+    int forks;                     // free forks
+    atomic_int owned;              // free forks plus those held by this shard's diners
+    atomic_int urgent;             // queued diners past T_priority
+    atomic_int needy;              // 1 if diners wait and fewer than 2 forks are free
+    long transfers;                // batches of forks received
+} __attribute__((aligned(64))) Shard;
+
+static Shard *sh;
+static Diner *dn;
+static long long *breq;
+static int nshards, fair_share;
+static atomic_int n_urgent, n_needy, bench_stop;
+static long long bench_end;         // when bench_stop was set
+static pthread_barrier_t bench_start;
+
+static void set_needy(Shard *s, int v){
+    if (atomic_load(&s->needy) == v) return;
+    atomic_store(&s->needy, v);
+    atomic_fetch_add(&n_needy, v ? 1 : -1);
+}
+
+// caller holds s->m
+static void shard_grant(Shard *s){
+    while (s->q.size > 0 && s->forks >= 2) {
+        int d = s->q.h[0];
+        h_remove(&s->q, d);
+        s->forks -= 2;
+        if (dn[d].prio) { dn[d].prio = 0; atomic_fetch_sub(&s->urgent, 1); atomic_fetch_sub(&n_urgent, 1); }
+        dn[d].granted = 1;
+        pthread_cond_signal(&dn[d].cv);
+    }
+    set_needy(s, s->q.size > 0);
+}
+
+// A needy shard below its fair share, or with `any`, any needy shard.
+static int wants_forks(Shard *x, int any){
+    return atomic_load(&x->needy) && (any || atomic_load(&x->owned) < fair_share);
+}
+
+/* Hand n forks (already taken off shard `from`) to an urgent shard, else a needy one below
+   its fair share (or any needy one with `any`), else back to `from`. */
+static void donate(int from, int n, int any){
+    for (int pass = 0; pass < 2 && n; pass++)
+        for (int k = 1; k < nshards && n; k++) {
+            Shard *x = &sh[(from + k) % nshards];
+            if (pass == 0 ? atomic_load(&x->urgent) == 0 : !wants_forks(x, any)) continue;
+            pthread_mutex_lock(&x->m);
+            if (pass == 0 ? atomic_load(&x->urgent) > 0 : x->q.size > 0) {
+                x->forks += n; atomic_fetch_add(&x->owned, n); x->transfers++; n = 0;
+                shard_grant(x);
+            }
+            pthread_mutex_unlock(&x->m);
+        }
+    if (n) {
+        Shard *s = &sh[from];
+        pthread_mutex_lock(&s->m);
+        s->forks += n; atomic_fetch_add(&s->owned, n);
+        shard_grant(s);
+        pthread_mutex_unlock(&s->m);
+    }
+}
+
+// 1 if some needy shard owns less than its fair share
+static int rebalance_wanted(void){
+    if (atomic_load(&n_needy) == 0) return 0;
+    for (int i = 0; i < nshards; i++) if (wants_forks(&sh[i], 0)) return 1;
+    return 0;
+}
+
+// Diner d has waited T: take every free fork from shards with no urgent waiters. Holds no lock.
+static int collect_forks(int self){
+    int got = 0;
+    for (int k = 1; k < nshards; k++) {
+        Shard *x = &sh[(self + k) % nshards];
+        pthread_mutex_lock(&x->m);
+        if (atomic_load(&x->urgent) == 0) {
+            int t = x->forks & ~1;
+            got += t; x->forks -= t; atomic_fetch_sub(&x->owned, t);
+        }
+        pthread_mutex_unlock(&x->m);
+    }
+    return got;
+}
+
+static int bench_request(int d){
+    Shard *s = &sh[dn[d].shard];
+    pthread_mutex_lock(&s->m);
+    int defer = atomic_load(&n_urgent) > 0 && atomic_load(&s->urgent) == 0;
+    if (s->q.size == 0 && s->forks >= 2 && !defer) {
+        s->forks -= 2;
+        pthread_mutex_unlock(&s->m);
+        return 1;
+    }
+    long long t0 = now_ns();
+    breq[d] = t0;
+    h_push(&s->q, d);
+    set_needy(s, 1);
+    while (!dn[d].granted && !atomic_load(&bench_stop)) {
+        if (dn[d].prio) { pthread_cond_wait(&dn[d].cv, &s->m); continue; }
+        long long abs = t0 + (long long)(T_priority * 1e9);
+        struct timespec ts = ns_to_ts(abs);
+        pthread_cond_timedwait(&dn[d].cv, &s->m, &ts);
+        if (dn[d].granted || now_ns() < abs) continue;
+        dn[d].prio = 1;
+        atomic_fetch_add(&s->urgent, 1);
+        atomic_fetch_add(&n_urgent, 1);
+        pthread_mutex_unlock(&s->m);
+        int got = collect_forks(dn[d].shard);
+        pthread_mutex_lock(&s->m);
+        if (got) { s->forks += got; atomic_fetch_add(&s->owned, got); s->transfers++; }
+        shard_grant(s);
+    }
+    int ok = dn[d].granted;
+    dn[d].granted = 0;
+    if (!ok) {  // stopped while queued
+        h_remove(&s->q, d);
+        if (dn[d].prio) { dn[d].prio = 0; atomic_fetch_sub(&s->urgent, 1); atomic_fetch_sub(&n_urgent, 1); }
+        set_needy(s, s->q.size > 0 && s->forks < 2);
+    }
+    pthread_mutex_unlock(&s->m);
+    long long w = (ok ? now_ns() : bench_end) - t0;   // still queued at stop: waited until then
+    if (w > dn[d].max_wait) dn[d].max_wait = w;
+    return ok;
+}
+
+static void bench_release(int d){
+    int si = dn[d].shard, give = 0, any = 0;
+    Shard *s = &sh[si];
+    pthread_mutex_lock(&s->m);
+    s->forks += 2;
+    if (atomic_load(&n_urgent) > 0 && atomic_load(&s->urgent) == 0) give = s->forks & ~1;
+    else if (atomic_load(&s->owned) >= fair_share + REBAL_BATCH && rebalance_wanted()) {
+        if (s->forks >= REBAL_BATCH) give = REBAL_BATCH;  // else keep saving returned forks
+    } else {
+        shard_grant(s);
+        if (s->q.size == 0 && atomic_load(&n_needy) > 0) { give = s->forks & ~1; any = 1; }
+    }
+    s->forks -= give;
+    atomic_fetch_sub(&s->owned, give);
+    pthread_mutex_unlock(&s->m);
+    if (give) donate(si, give, any);
+}
+
+static void* bench_diner(void* arg){
+    int d = (int)(long)arg;
+    pthread_barrier_wait(&bench_start);
+    while (!atomic_load(&bench_stop)) {
+        if (!bench_request(d)) break;
+        long long until = now_ns() + BENCH_EAT_NS;
+        while (now_ns() < until) ;
+        dn[d].grants++;
+        bench_release(d);
+    }
+    return NULL;
+}
+
+/* Grants per second, Jain's fairness index over per-diner grants, the longest wait (including diners
+   still queued at stop) and the fork batches moved between shards, for S = 1, 2, 4, ... max_shards. */
+static int run_bench(int n, int f, int secs, int max_shards){
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, BENCH_STACK);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_t *P = (pthread_t*)malloc(sizeof(pthread_t)*n);
+    dn = (Diner*)aligned_alloc(64, sizeof(Diner)*n);
+    breq = (long long*)malloc(sizeof(long long)*n);
+    int *pos = (int*)malloc(sizeof(int)*n);
+    double *x = (double*)malloc(sizeof(double)*n);
+    if (!P || !dn || !breq || !pos || !x) { fprintf(stderr, "Allocation failed\n"); return 1; }
+
+    printf("%d diners, %d forks, T = %.2fs, %ds per run\n", n, f, T_priority, secs);
+    printf("%6s %12s %8s %10s %10s %s\n", "shards", "grants/s", "Jain", "max wait", "transfers", "forks");
+    int ok = 1;
+    for (int S = 1; S <= max_shards; S *= 2) {
+        nshards = S;
+        fair_share = (f & ~1) / S;
+        sh = (Shard*)aligned_alloc(64, sizeof(Shard)*S);
+        for (int i = 0; i < S; i++) {
+            pthread_mutex_init(&sh[i].m, NULL);
+            sh[i].q.h = (int*)malloc(sizeof(int)*n);
+            sh[i].q.pos = pos;
+            sh[i].q.key = breq;
+            sh[i].q.size = 0;
+            sh[i].forks = 0;
+            atomic_init(&sh[i].owned, 0);
+            atomic_init(&sh[i].urgent, 0);
+            atomic_init(&sh[i].needy, 0);
+            sh[i].transfers = 0;
+        }
+        for (int p = 0; p < f/2; p++) {  // an odd fork is never usable
+            sh[p % S].forks += 2;
+            atomic_fetch_add(&sh[p % S].owned, 2);
+        }
+        for (int d = 0; d < n; d++) {
+            memset(&dn[d], 0, sizeof(Diner));
+            pthread_cond_init(&dn[d].cv, &ca);
+            dn[d].shard = d % S;
+            pos[d] = -1;
+        }
+        atomic_store(&n_urgent, 0);
+        atomic_store(&n_needy, 0);
+        atomic_store(&bench_stop, 0);
+
+        // time from when every diner exists, or the first created get a head start
+        pthread_barrier_init(&bench_start, NULL, n + 1);
+        for (long d = 0; d < n; d++) pthread_create(&P[d], &attr, bench_diner, (void*)d);
+        pthread_barrier_wait(&bench_start);
+        long long t0 = now_ns();
+        msleep(secs * 1000);
+        bench_end = now_ns();
+        atomic_store(&bench_stop, 1);
+        for (int d = 0; d < n; d++) {
+            pthread_mutex_lock(&sh[dn[d].shard].m);
+            pthread_cond_signal(&dn[d].cv);
+            pthread_mutex_unlock(&sh[dn[d].shard].m);
+        }
+        for (int d = 0; d < n; d++) pthread_join(P[d], NULL);
+        double el = (bench_end - t0) / 1e9;
+        pthread_barrier_destroy(&bench_start);
+
+        double sum = 0;
+        long long mw = 0;
+        long transfers = 0;
+        int forks = 0, kept_owned = 1;
+        for (int d = 0; d < n; d++) {
+            sum += dn[d].grants;
+            x[d] = dn[d].grants;
+            if (dn[d].max_wait > mw) mw = dn[d].max_wait;
+            pthread_cond_destroy(&dn[d].cv);
+        }
+        for (int i = 0; i < S; i++) {
+            forks += sh[i].forks; transfers += sh[i].transfers;
+            kept_owned &= atomic_load(&sh[i].owned) == sh[i].forks;
+            pthread_mutex_destroy(&sh[i].m);
+            free(sh[i].q.h);
+        }
+        int kept = forks == (f & ~1) && kept_owned;
+        ok &= kept;
+        printf("%6d %12.0f %8.4f %9.3fs %10ld %s\n", S, sum / el, jain(x, n),
+               mw / 1e9, transfers, kept ? "ok" : "LOST");
+        free(sh);
+    }
+    pthread_attr_destroy(&attr);
+    pthread_condattr_destroy(&ca);
+    free(P); free(dn); free(breq); free(pos); free(x);
+    return ok ? 0 : 1;
+}
+
 int main(int argc, char **argv){
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int n = argc >= 3 ? atoi(argv[2]) : 2000, f = argc >= 4 ? atoi(argv[3]) : 64;
+        if (argc >= 5) T_priority = atof(argv[4]);
+        int secs = argc >= 6 ? atoi(argv[5]) : 2, max_shards = argc >= 7 ? atoi(argv[6]) : 16;
+        if (n < 2 || f < 2 || secs < 1 || max_shards < 1) {
+            fprintf(stderr, "Usage: %s bench [diners] [forks] [T_seconds] [seconds] [max_shards]\n", argv[0]);
+            return 1;
+        }
+        return run_bench(n, f, secs, max_shards);
+    }
     if (argc >= 2) N = atoi(argv[1]);
     if (argc >= 3) F = atoi(argv[2]);
     if (argc >= 4) T_priority = atof(argv[3]);
@@ -194,14 +510,25 @@ int main(int argc, char **argv){
     ph_cv = (condpair_t*)malloc(sizeof(condpair_t)*N);
     waiting = (int*)calloc(N,sizeof(int));
     granted = (int*)calloc(N,sizeof(int));
-    req_time = (double*)calloc(N,sizeof(double));
+    req_ns = (long long*)calloc(N,sizeof(long long));
     eats = (int*)calloc(N,sizeof(int));
-    wait_sum = (double*)calloc(N,sizeof(double));
-    wait_max = (double*)calloc(N,sizeof(double));
+    waits = (Hist*)calloc(N,sizeof(Hist));
     active = (int*)calloc(N,sizeof(int));
     join_at_sec = (double*)calloc(N,sizeof(double));
     leave_at_sec = (double*)calloc(N,sizeof(double));
-    q_init(4*N+8);
+    prio_grants = (int*)calloc(N,sizeof(int));
+    prio = (int*)calloc(N,sizeof(int));
+    wq.h = (int*)malloc(sizeof(int)*N);
+    wq.pos = (int*)malloc(sizeof(int)*N);
+    wq.key = req_ns;
+    for (int i=0;i<N;i++) wq.pos[i] = -1;
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&waiter_cv, &ca);
+    pthread_condattr_destroy(&ca);
+    t0_ns = now_ns();
 
     join_at_sec[0] = 5.0;        
     if (N > 3) leave_at_sec[3] = 30.0;
@@ -225,13 +552,15 @@ int main(int argc, char **argv){
 
     for (int i=0;i<N;i++) pthread_join(P[i], NULL);
     pthread_join(W, NULL);
+    report();
 
     for (int i=0;i<N;i++){
         pthread_mutex_destroy(&ph_cv[i].m);
         pthread_cond_destroy(&ph_cv[i].c);
     }
-    free(P); free(Q);
-    free(ph_cv); free(waiting); free(granted); free(req_time);
-    free(eats); free(wait_sum); free(wait_max); free(active);
+    pthread_cond_destroy(&waiter_cv);
+    free(P); free(wq.h); free(wq.pos); free(prio); free(prio_grants);
+    free(ph_cv); free(waiting); free(granted); free(req_ns);
+    free(eats); free(waits); free(active);
     free(join_at_sec); free(leave_at_sec);
 }
\ No newline at end of file
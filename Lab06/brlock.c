@@ -0,0 +1,162 @@
+#include "brlock.h"
+#include <stdlib.h>
+#include <sched.h>
+#include <limits.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BR_SPIN 16   // sched_yield() calls before a waiter parks
+
+/* Both sides store their own flag and then load the other's (all sequentially consistent),
+   so a reader and a writer that arrive together cannot both miss each other.
+
+   Readers preference: a reader raises its flag and, if a writer holds the lock, waits with
+   the flag still raised. A writer raises `writer` and then checks the reader flags. If any
+   flag is up it drops `writer` and waits for the readers to leave. So a waiting writer
+   never holds back a reader.
+
+   Writers preference: a writer counts itself in `writer` before queueing on wlock. Readers
+   wait until that count is zero, raise their flag and back off again if a writer arrived
+   meanwhile. So new readers stay out while any writer is waiting, as with readTry.
+
+   Waiting: readers wait on readers_ev for `writer` to drop, writers on writers_ev for the
+   flags to clear. A waiter registers on the event before re-checking its condition, and
+   every store that can end a wait is followed by ev_notify, which skips the wake-up when
+   nobody registered. */
+
+static void ev_init(br_event *e) {
+    atomic_init(&e->seq, 0);
+    atomic_init(&e->waiters, 0);
+#ifndef __linux__
+    pthread_mutex_init(&e->m, NULL);
+    pthread_cond_init(&e->c, NULL);
+#endif
+}
+
+static void ev_destroy(br_event *e) {
+#ifndef __linux__
+    pthread_mutex_destroy(&e->m);
+    pthread_cond_destroy(&e->c);
+#else
+    (void)e;
+#endif
+}
+
+static void ev_wait(br_event *e, unsigned seen) {
+#ifdef __linux__
+    syscall(SYS_futex, &e->seq, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&e->m);
+    while (atomic_load(&e->seq) == seen) pthread_cond_wait(&e->c, &e->m);
+    pthread_mutex_unlock(&e->m);
+#endif
+}
+
+// Wake every thread parked on e.
+static void ev_notify(br_event *e) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&e->waiters, memory_order_relaxed) == 0) return;
+#ifdef __linux__
+    atomic_fetch_add(&e->seq, 1);
+    syscall(SYS_futex, &e->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&e->m);
+    atomic_fetch_add(&e->seq, 1);
+    pthread_cond_broadcast(&e->c);
+    pthread_mutex_unlock(&e->m);
+#endif
+}
+
+// Wait until ready(l): yield BR_SPIN times, then park on e until a release bumps it.
+static void br_wait(brlock *l, br_event *e, int (*ready)(brlock*)) {
+    for (int i = 0; !ready(l); i++) {
+        if (i < BR_SPIN) { sched_yield(); continue; }
+        atomic_fetch_add(&e->waiters, 1);
+        unsigned seen = atomic_load(&e->seq);
+        if (!ready(l)) ev_wait(e, seen);
+        atomic_fetch_sub(&e->waiters, 1);
+    }
+}
+
+int br_init(brlock *l, int nreaders, br_policy policy) {
+    l->slots = (br_slot*)aligned_alloc(64, sizeof(br_slot) * nreaders);
+    if (!l->slots) return -1;
+    l->nslots = nreaders;
+    l->policy = policy;
+    for (int i = 0; i < nreaders; i++) atomic_init(&l->slots[i].active, 0);
+    atomic_init(&l->writer, 0);
+    pthread_mutex_init(&l->wlock, NULL);
+    ev_init(&l->readers_ev);
+    ev_init(&l->writers_ev);
+    return 0;
+}
+
+void br_destroy(brlock *l) {
+    pthread_mutex_destroy(&l->wlock);
+    ev_destroy(&l->readers_ev);
+    ev_destroy(&l->writers_ev);
+    free(l->slots);
+    l->slots = NULL;
+}
+
+static int readers_present(brlock *l) {
+    for (int i = 0; i < l->nslots; i++)
+        if (atomic_load(&l->slots[i].active)) return 1;
+    return 0;
+}
+
+static int no_readers(brlock *l) { return !readers_present(l); }
+static int no_writer(brlock *l) { return atomic_load(&l->writer) == 0; }
+
+void br_read_lock(brlock *l, int reader) {
+    atomic_int *mine = &l->slots[reader].active;
+    if (l->policy == BR_READERS_PREF) {
+        atomic_store(mine, 1);
+        br_wait(l, &l->readers_ev, no_writer);
+        return;
+    }
+    for (;;) {
+        br_wait(l, &l->readers_ev, no_writer);
+        atomic_store(mine, 1);
+        if (!atomic_load(&l->writer)) return;
+        atomic_store(mine, 0);   // a writer arrived: let it go first
+        ev_notify(&l->writers_ev);
+    }
+}
+
+void br_read_unlock(brlock *l, int reader) {
+    atomic_store_explicit(&l->slots[reader].active, 0, memory_order_release);
+    ev_notify(&l->writers_ev);
+}
+
+void br_write_lock(brlock *l) {
+    if (l->policy == BR_WRITERS_PREF) {
+        atomic_fetch_add(&l->writer, 1);
+        pthread_mutex_lock(&l->wlock);
+        br_wait(l, &l->writers_ev, no_readers);
+        return;
+    }
+    pthread_mutex_lock(&l->wlock);
+    for (;;) {
+        br_wait(l, &l->writers_ev, no_readers);
+        atomic_store(&l->writer, 1);
+        if (!readers_present(l)) return;
+        atomic_store(&l->writer, 0);   // a reader got in first: it has priority
+        ev_notify(&l->readers_ev);
+    }
+}
+
+void br_write_unlock(brlock *l) {
+    if (l->policy == BR_WRITERS_PREF) {
+        pthread_mutex_unlock(&l->wlock);
+        atomic_fetch_sub(&l->writer, 1);
+        ev_notify(&l->readers_ev);
+        return;
+    }
+    atomic_store(&l->writer, 0);
+    ev_notify(&l->readers_ev);
+    pthread_mutex_unlock(&l->wlock);
+}
@@ -0,0 +1,46 @@
+#ifndef BRLOCK_H
+#define BRLOCK_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* Big-reader lock: every reader owns a padded flag in its own cache line, so taking and
+   dropping a read lock writes only that line. A writer scans all flags instead of waiting
+   on a shared reader count. Readers are identified by a slot index 0..nreaders-1.
+   Waiters yield a few times and then sleep until a release wakes them. */
+
+typedef enum { BR_READERS_PREF, BR_WRITERS_PREF } br_policy;
+
+typedef struct { _Alignas(64) atomic_int active; } br_slot;
+
+/* Event count a waiter parks on after BR_SPIN yields; releases bump it and wake the
+   parked threads, if any registered. */
+typedef struct {
+    _Alignas(64) _Atomic unsigned seq;
+    atomic_int waiters;
+#ifndef __linux__
+    pthread_mutex_t m;
+    pthread_cond_t c;
+#endif
+} br_event;
+
+typedef struct {
+    br_slot *slots;
+    int nslots;
+    br_policy policy;
+    _Alignas(64) atomic_int writer;   // readers pref: a writer holds the lock
+                                      // writers pref: writers holding or waiting for it
+    pthread_mutex_t wlock;            // serialises writers
+    br_event readers_ev;              // readers waiting for the writer(s) to leave
+    br_event writers_ev;              // a writer waiting for the readers to leave
+} brlock;
+
+int br_init(brlock *l, int nreaders, br_policy policy);
+void br_destroy(brlock *l);
+
+void br_read_lock(brlock *l, int reader);
+void br_read_unlock(brlock *l, int reader);
+void br_write_lock(brlock *l);
+void br_write_unlock(brlock *l);
+
+#endif
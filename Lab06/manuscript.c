@@ -0,0 +1,245 @@
+#include "manuscript.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+
+#define CACHE_LINE 64
+
+/* Seqlock: the counter is odd while a librarian writes. Readers copy the fields with relaxed
+   atomic loads and keep the copy only if the counter was even and unchanged around it. */
+static struct {
+    _Alignas(CACHE_LINE) atomic_uint seq;
+    atomic_int version, editor;
+    atomic_uint check;
+} seq;
+
+/* RCU: readers announce the global epoch in their own cache line before loading the
+   pointer and clear it (0 = quiescent) when done. A replaced document is tagged with the
+   epoch current at the swap, then the epoch advances; it is freed once every reader that
+   is inside a read section announced a later epoch, since those loaded the new pointer. */
+typedef struct { _Alignas(CACHE_LINE) atomic_ulong epoch; } Slot;
+
+static _Atomic(ms_doc*) current;
+static atomic_ulong global_epoch = 1;
+static Slot *slots;
+static int nslots;
+static ms_doc *retired;           // oldest last; writer only
+static long npending;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned snapshot_check(int version, int editor) {
+    return (unsigned)version * 2654435761u ^ (unsigned)editor;
+}
+
+static char doc_char(int version, size_t i) { return (char)('a' + (version + i) % 26); }
+
+static ms_doc *doc_new(int version, int editor) {
+    ms_doc *d = (ms_doc*)malloc(sizeof(ms_doc) + MS_DOC_BYTES);
+    if (!d) return NULL;
+    d->version = version;
+    d->editor = editor;
+    d->retired_at = 0;
+    d->next = NULL;
+    d->len = MS_DOC_BYTES;
+    for (size_t i = 0; i < d->len; i++) d->text[i] = doc_char(version, i);
+    return d;
+}
+
+int ms_parse_mode(const char *name) {
+    if (strcmp(name, "sem") == 0) return MS_SEM;
+    if (strcmp(name, "seqlock") == 0) return MS_SEQLOCK;
+    if (strcmp(name, "rcu") == 0) return MS_RCU;
+    if (strcmp(name, "brlock") == 0) return MS_BRLOCK;
+    return -1;
+}
+
+int ms_optimistic(ms_mode mode) { return mode == MS_SEQLOCK || mode == MS_RCU; }
+
+int ms_init(int nreaders) {
+    if (nreaders < 1 || nreaders > MS_MAX_READERS) {
+        fprintf(stderr, "ms_init: at most %d readers\n", MS_MAX_READERS);
+        return -1;
+    }
+    slots = (Slot*)aligned_alloc(CACHE_LINE, sizeof(Slot) * nreaders);
+    ms_doc *d = doc_new(0, 0);
+    if (!slots || !d) { free(slots); free(d); return -1; }
+    nslots = nreaders;
+    for (int i = 0; i < nslots; i++) atomic_init(&slots[i].epoch, 0);
+    atomic_store(&current, d);
+    atomic_store(&seq.seq, 0);
+    atomic_store(&seq.version, 0);
+    atomic_store(&seq.editor, 0);
+    atomic_store(&seq.check, snapshot_check(0, 0));
+    retired = NULL;
+    npending = 0;
+    return 0;
+}
+
+void ms_cleanup(void) {
+    while (retired) { ms_doc *n = retired->next; free(retired); retired = n; }
+    free(atomic_exchange(&current, NULL));
+    free(slots);
+    slots = NULL;
+    npending = 0;
+}
+
+// Free retired documents older than every epoch announced by a reader in a read section.
+static void reclaim(void) {
+    unsigned long min = ULONG_MAX;
+    for (int i = 0; i < nslots; i++) {
+        unsigned long e = atomic_load(&slots[i].epoch);
+        if (e && e < min) min = e;
+    }
+    ms_doc **p = &retired;
+    while (*p) {
+        if ((*p)->retired_at < min) {
+            ms_doc *d = *p;
+            *p = d->next;
+            free(d);
+            npending--;
+        } else p = &(*p)->next;
+    }
+}
+
+void ms_publish(int version, int editor) {
+    ms_doc *d = doc_new(version, editor);   // built outside the lock
+    pthread_mutex_lock(&write_lock);
+
+    unsigned s = atomic_load_explicit(&seq.seq, memory_order_relaxed);
+    atomic_store_explicit(&seq.seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&seq.version, version, memory_order_relaxed);
+    atomic_store_explicit(&seq.editor, editor, memory_order_relaxed);
+    atomic_store_explicit(&seq.check, snapshot_check(version, editor), memory_order_relaxed);
+    atomic_store_explicit(&seq.seq, s + 2, memory_order_release);
+
+    if (d) {
+        ms_doc *old = atomic_exchange(&current, d);
+        old->retired_at = atomic_fetch_add(&global_epoch, 1);
+        old->next = retired;
+        retired = old;
+        npending++;
+        reclaim();
+    }
+    pthread_mutex_unlock(&write_lock);
+}
+
+ms_snapshot ms_read_snapshot(void) {
+    ms_snapshot s;
+    unsigned s1, s2;
+    do {
+        while ((s1 = atomic_load_explicit(&seq.seq, memory_order_acquire)) & 1) ;
+        s.version = atomic_load_explicit(&seq.version, memory_order_relaxed);
+        s.editor = atomic_load_explicit(&seq.editor, memory_order_relaxed);
+        s.check = atomic_load_explicit(&seq.check, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&seq.seq, memory_order_relaxed);
+    } while (s1 != s2);
+    return s;
+}
+
+int ms_snapshot_ok(const ms_snapshot *s) { return s->check == snapshot_check(s->version, s->editor); }
+
+const ms_doc *ms_rcu_enter(int reader) {
+    atomic_store(&slots[reader].epoch, atomic_load(&global_epoch));
+    return atomic_load(&current);
+}
+
+void ms_rcu_exit(int reader) {
+    atomic_store_explicit(&slots[reader].epoch, 0, memory_order_release);
+}
+
+int ms_doc_ok(const ms_doc *d) {
+    return d->len == MS_DOC_BYTES && d->text[0] == doc_char(d->version, 0) &&
+           d->text[d->len - 1] == doc_char(d->version, d->len - 1);
+}
+
+long ms_retired_pending(void) {
+    pthread_mutex_lock(&write_lock);
+    long n = npending;
+    pthread_mutex_unlock(&write_lock);
+    return n;
+}
+
+int ms_bench_read_seqlock(int reader) {
+    (void)reader;
+    ms_snapshot snap = ms_read_snapshot();
+    return ms_snapshot_ok(&snap);
+}
+
+int ms_bench_read_rcu(int reader) {
+    int ok = ms_doc_ok(ms_rcu_enter(reader));
+    ms_rcu_exit(reader);
+    return ok;
+}
+
+typedef struct { _Alignas(CACHE_LINE) long reads, bad; } BenchCount;
+
+static atomic_int bench_stop;
+static BenchCount *bench_counts;
+static const ms_bench_mode *bench_mode;
+
+static void *bench_reader(void *arg) {
+    int r = (int)(long)arg;
+    long n = 0, bad = 0;
+    while (!atomic_load_explicit(&bench_stop, memory_order_relaxed)) {
+        bad += !bench_mode->read(r);
+        n++;
+    }
+    bench_counts[r].reads = n;
+    bench_counts[r].bad = bad;
+    return NULL;
+}
+
+static void *bench_librarian(void *arg) {
+    long *writes = (long*)arg;
+    struct timespec gap = { 0, MS_BENCH_WRITE_US * 1000L };
+    while (!atomic_load(&bench_stop)) {
+        bench_mode->write();
+        ++*writes;
+        nanosleep(&gap, NULL);
+    }
+    return NULL;
+}
+
+long ms_bench(const ms_bench_mode *modes, int nmodes, int max_threads, int secs) {
+    pthread_t *readers = (pthread_t*)malloc(sizeof(pthread_t) * max_threads);
+    bench_counts = (BenchCount*)aligned_alloc(CACHE_LINE, sizeof(BenchCount) * max_threads);
+    if (!readers || !bench_counts || ms_init(max_threads) != 0) return -1;
+    printf("Mreads/s (versions published), %ds per run, a write every %d us\n", secs, MS_BENCH_WRITE_US);
+    printf("%7s", "readers");
+    for (int m = 0; m < nmodes; m++) printf(" %20s", modes[m].name);
+    printf("\n");
+    long bad = 0;
+    for (int t = 1; t <= max_threads; t *= 2) {
+        printf("%7d", t);
+        for (int m = 0; m < nmodes; m++) {
+            bench_mode = &modes[m];
+            long writes = 0, reads = 0;
+            atomic_store(&bench_stop, 0);
+            pthread_t lib;
+            pthread_create(&lib, NULL, bench_librarian, &writes);
+            for (long r = 0; r < t; r++) pthread_create(&readers[r], NULL, bench_reader, (void*)r);
+            struct timespec run = { secs, 0 };
+            nanosleep(&run, NULL);
+            atomic_store(&bench_stop, 1);
+            for (int r = 0; r < t; r++) {
+                pthread_join(readers[r], NULL);
+                reads += bench_counts[r].reads;
+                bad += bench_counts[r].bad;
+            }
+            pthread_join(lib, NULL);
+            printf(" %11.2f (%6ld)", reads / 1e6 / secs, writes);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    printf("inconsistent reads: %ld, documents awaiting reclamation: %ld\n", bad, ms_retired_pending());
+    ms_cleanup();
+    free(readers); free(bench_counts);
+    return bad;
+}
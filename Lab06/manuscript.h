@@ -0,0 +1,66 @@
+#ifndef MANUSCRIPT_H
+#define MANUSCRIPT_H
+
+#include <stddef.h>
+
+/* Optimistic read paths for the manuscript. Students read without touching any semaphore:
+   - seqlock: a small POD snapshot, copied and retried if a librarian wrote meanwhile;
+   - rcu:     a larger document behind a pointer that librarians swap, freed by epochs once
+              no reader can still hold it.
+   In these two modes librarians call ms_publish after updating the version; publishes are
+   serialised inside. Only these two modes need ms_init.
+   (MS_BRLOCK reads under the distributed reader-writer lock of brlock.c instead.) */
+
+#define MS_MAX_READERS 1024   // RCU reader slots, one per student
+#define MS_DOC_BYTES 4096     // text size of each published document
+
+typedef enum { MS_SEM, MS_SEQLOCK, MS_RCU, MS_BRLOCK } ms_mode;
+
+typedef struct {
+    int version;
+    int editor;               // librarian that published it
+    unsigned check;           // function of version and editor, to detect torn copies
+} ms_snapshot;
+
+typedef struct ms_doc {
+    int version;
+    int editor;
+    unsigned long retired_at; // epoch at which it was replaced
+    struct ms_doc *next;      // retired list
+    size_t len;
+    char text[];
+} ms_doc;
+
+int ms_parse_mode(const char *name);   // "sem", "seqlock", "rcu" or "brlock"; -1 if unknown
+int ms_optimistic(ms_mode mode);       // seqlock or rcu: the modes that use ms_init/ms_publish
+int ms_init(int nreaders);             // readers use slots 0..nreaders-1
+void ms_cleanup(void);
+
+void ms_publish(int version, int editor);
+
+ms_snapshot ms_read_snapshot(void);
+int ms_snapshot_ok(const ms_snapshot *s);
+
+const ms_doc *ms_rcu_enter(int reader);   // the doc stays valid until ms_rcu_exit
+void ms_rcu_exit(int reader);
+int ms_doc_ok(const ms_doc *d);
+
+long ms_retired_pending(void);         // replaced documents not yet freed
+
+/* Read throughput: for each mode and 1, 2, 4, ... max_threads reader threads, readers call
+   read(slot) in a loop for `secs` while one librarian calls write() every MS_BENCH_WRITE_US.
+   read returns 0 for an inconsistent read. Prints million reads/s and the versions published
+   per cell; returns the number of inconsistent reads. Calls ms_init itself. */
+#define MS_BENCH_WRITE_US 1000
+
+typedef struct {
+    const char *name;
+    int (*read)(int reader);
+    void (*write)(void);
+} ms_bench_mode;
+
+long ms_bench(const ms_bench_mode *modes, int nmodes, int max_threads, int secs);
+int ms_bench_read_seqlock(int reader);
+int ms_bench_read_rcu(int reader);
+
+#endif
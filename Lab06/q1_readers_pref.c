@@ -3,6 +3,9 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <string.h>
+#include "manuscript.h"
+#include "brlock.h"
 
 int manuscript_data = 0;
 sem_t mutex; // protects readcount
@@ -10,6 +13,22 @@ sem_t wrt;   // allows writers exclusive access
 int readcount = 0;
 
 int num_students, num_librarians, num_accesses;
+ms_mode mode = MS_SEM; // how students read: semaphores, seqlock snapshot, RCU document or brlock
+brlock br;             // readers-preference big-reader lock, replaces mutex/wrt in brlock mode
+
+void read_enter(void) {
+    sem_wait(&mutex);
+    readcount++;
+    if (readcount == 1) sem_wait(&wrt); // first reader locks writers out
+    sem_post(&mutex);
+}
+
+void read_exit(void) {
+    sem_wait(&mutex);
+    readcount--;
+    if (readcount == 0) sem_post(&wrt); // last reader releases writers
+    sem_post(&mutex);
+}
 
 void *student(void *arg) {
     int id = *(int*)arg;
@@ -17,20 +36,28 @@ void *student(void *arg) {
     for (int k = 0; k < num_accesses; ++k) {
         printf("Student %d is waiting to read.\n", id); fflush(stdout);
 
-        sem_wait(&mutex);
-        readcount++;
-        if (readcount == 1) sem_wait(&wrt); // first reader locks writers out
-        sem_post(&mutex);
-
-        printf("Student %d is now reading (version: %d).\n", id, manuscript_data); fflush(stdout);
-        sleep(1); // simulate reading
+        if (mode == MS_SEQLOCK) {
+            ms_snapshot snap = ms_read_snapshot(); // read a private copy, no lock held
+            printf("Student %d is now reading (version: %d).\n", id, snap.version); fflush(stdout);
+            sleep(1); // simulate reading
+        } else if (mode == MS_RCU) {
+            const ms_doc *doc = ms_rcu_enter(id - 1); // librarians may publish meanwhile
+            printf("Student %d is now reading (version: %d).\n", id, doc->version); fflush(stdout);
+            sleep(1); // simulate reading
+            ms_rcu_exit(id - 1);
+        } else if (mode == MS_BRLOCK) {
+            br_read_lock(&br, id - 1); // writes only this student's own flag
+            printf("Student %d is now reading (version: %d).\n", id, manuscript_data); fflush(stdout);
+            sleep(1); // simulate reading
+            br_read_unlock(&br, id - 1);
+        } else {
+            read_enter();
+            printf("Student %d is now reading (version: %d).\n", id, manuscript_data); fflush(stdout);
+            sleep(1); // simulate reading
+            read_exit();
+        }
         printf("Student %d has finished reading.\n", id); fflush(stdout);
 
-        sem_wait(&mutex);
-        readcount--;
-        if (readcount == 0) sem_post(&wrt); // last reader releases writers
-        sem_post(&mutex);
-
         sleep(1); // wait before next attempt
     }
     return NULL;
@@ -41,28 +68,90 @@ void *librarian(void *arg) {
     free(arg);
     for (int k = 0; k < num_accesses; ++k) {
         printf("Librarian %d is waiting to write.\n", id); fflush(stdout);
-        sem_wait(&wrt); // exclusive access
+        if (mode == MS_BRLOCK) br_write_lock(&br);
+        else sem_wait(&wrt); // exclusive access
         printf("Librarian %d is now writing.\n", id); fflush(stdout);
         sleep(1); // simulate writing
         manuscript_data++;
+        if (ms_optimistic(mode)) ms_publish(manuscript_data, id);
         printf("Librarian %d has finished writing (new version: %d).\n", id, manuscript_data); fflush(stdout);
-        sem_post(&wrt);
+        if (mode == MS_BRLOCK) br_write_unlock(&br);
+        else sem_post(&wrt);
         sleep(1); // wait before next attempt
     }
     return NULL;
 }
 
+/* Read throughput of the semaphore protocol above, the big-reader lock with the same
+   readers preference, the seqlock and RCU (see ms_bench). */
+static int bench_read_sem(int reader) {
+    (void)reader;
+    read_enter();
+    int ok = manuscript_data >= 0;
+    read_exit();
+    return ok;
+}
+
+static int bench_read_br(int reader) {
+    br_read_lock(&br, reader);
+    int ok = manuscript_data >= 0;
+    br_read_unlock(&br, reader);
+    return ok;
+}
+
+static void bench_write_sem(void) {
+    sem_wait(&wrt);
+    manuscript_data++;
+    ms_publish(manuscript_data, 1);
+    sem_post(&wrt);
+}
+
+static void bench_write_br(void) {
+    br_write_lock(&br);
+    manuscript_data++;
+    ms_publish(manuscript_data, 1);
+    br_write_unlock(&br);
+}
+
+int run_bench(int max_threads, int secs) {
+    static const ms_bench_mode modes[] = {
+        { "sem", bench_read_sem, bench_write_sem },
+        { "brlock", bench_read_br, bench_write_br },
+        { "seqlock", ms_bench_read_seqlock, bench_write_sem },
+        { "rcu", ms_bench_read_rcu, bench_write_sem },
+    };
+    if (br_init(&br, max_threads, BR_READERS_PREF) != 0) return 1;
+    long bad = ms_bench(modes, 4, max_threads, secs);
+    br_destroy(&br);
+    return bad == 0 ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <#students> <#librarians> <#accesses>\n", argv[0]);
+    sem_init(&mutex, 0, 1);
+    sem_init(&wrt, 0, 1);
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int max_threads = argc >= 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int secs = argc >= 4 ? atoi(argv[3]) : 1;
+        if (max_threads < 1 || max_threads > MS_MAX_READERS || secs < 1) {
+            fprintf(stderr, "Usage: %s bench [max_threads] [seconds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        return run_bench(max_threads, secs);
+    }
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "Usage: %s <#students> <#librarians> <#accesses> [sem|seqlock|rcu|brlock]\n", argv[0]);
+        fprintf(stderr, "       %s bench [max_threads] [seconds]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
     num_students = atoi(argv[1]);
     num_librarians = atoi(argv[2]);
     num_accesses = atoi(argv[3]);
-
-    sem_init(&mutex, 0, 1);
-    sem_init(&wrt, 0, 1);
+    if (argc == 5 && (int)(mode = (ms_mode)ms_parse_mode(argv[4])) < 0) {
+        fprintf(stderr, "Unknown read mode %s\n", argv[4]);
+        exit(EXIT_FAILURE);
+    }
+    if (ms_optimistic(mode) && ms_init(num_students > 0 ? num_students : 1) != 0) exit(EXIT_FAILURE);
+    if (mode == MS_BRLOCK && br_init(&br, num_students > 0 ? num_students : 1, BR_READERS_PREF) != 0) exit(EXIT_FAILURE);
 
     pthread_t *students = malloc(sizeof(pthread_t) * num_students);
     pthread_t *librarians = malloc(sizeof(pthread_t) * num_librarians);
@@ -82,6 +171,8 @@ int main(int argc, char *argv[]) {
     printf("All threads have completed their tasks.\n");
     fflush(stdout);
 
+    if (ms_optimistic(mode)) ms_cleanup();
+    if (mode == MS_BRLOCK) br_destroy(&br);
     sem_destroy(&mutex);
     sem_destroy(&wrt);
     free(students);
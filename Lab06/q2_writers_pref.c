@@ -3,6 +3,9 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <string.h>
+#include "manuscript.h"
+#include "brlock.h"
 
 sem_t resource;   // controls access to manuscript (readers use it for first/last)
 sem_t rmutex;     // protects readcount
@@ -14,28 +17,76 @@ int writecount = 0;
 int manuscript = 0;
 
 int num_students, num_librarians;
+ms_mode mode = MS_SEM; // how students read: semaphores, seqlock snapshot, RCU document or brlock
+brlock br;             // writers-preference big-reader lock, replaces the semaphores in brlock mode
+
+void read_enter(void) {
+    sem_wait(&readTry);           // wait unless writers are wanting
+    sem_wait(&rmutex);
+    readcount++;
+    if (readcount == 1) sem_wait(&resource); // first reader locks resource
+    sem_post(&rmutex);
+    sem_post(&readTry);
+}
+
+void read_exit(void) {
+    sem_wait(&rmutex);
+    readcount--;
+    if (readcount == 0) sem_post(&resource); // last reader releases
+    sem_post(&rmutex);
+}
+
+void write_enter(void) {
+    sem_wait(&wmutex);
+    writecount++;
+    if (writecount == 1) sem_wait(&readTry); // first writer blocks new readers
+    sem_post(&wmutex);
+    sem_wait(&resource); // exclusive access
+}
+
+void write_exit(void) {
+    sem_post(&resource);
+    sem_wait(&wmutex);
+    writecount--;
+    if (writecount == 0) sem_post(&readTry); // last writer allows readers
+    sem_post(&wmutex);
+}
 
 void *student(void *arg) {
     int id = *(int*)arg; free(arg);
     while (1) {
         printf("[Student %d] wants to read.\n", id); fflush(stdout);
 
-        sem_wait(&readTry);           // wait unless writers are wanting
-        sem_wait(&rmutex);
-        readcount++;
-        if (readcount == 1) sem_wait(&resource); // first reader locks resource
-        sem_post(&rmutex);
-        sem_post(&readTry);
+        if (mode == MS_SEQLOCK) {
+            // optimistic: copy a consistent snapshot, writers never wait for us
+            ms_snapshot snap = ms_read_snapshot();
+            printf("[Student %d] is READING (version %d).\n", id, snap.version); fflush(stdout);
+            sleep(1);
+            printf("[Student %d] finished READING.\n", id); fflush(stdout);
+            sleep(1);
+            continue;
+        }
+        if (mode == MS_RCU) {
+            // the document stays valid until we leave, even if librarians publish newer ones
+            const ms_doc *doc = ms_rcu_enter(id - 1);
+            printf("[Student %d] is READING (version %d).\n", id, doc->version); fflush(stdout);
+            sleep(1);
+            printf("[Student %d] finished READING.\n", id); fflush(stdout);
+            ms_rcu_exit(id - 1);
+            sleep(1);
+            continue;
+        }
+
+        if (mode == MS_BRLOCK) br_read_lock(&br, id - 1);
+        else read_enter();
 
         // reading (critical section for read)
         printf("[Student %d] is READING (version %d).\n", id, manuscript); fflush(stdout);
         sleep(1);
         printf("[Student %d] finished READING.\n", id); fflush(stdout);
 
-        sem_wait(&rmutex);
-        readcount--;
-        if (readcount == 0) sem_post(&resource); // last reader releases
-        sem_post(&rmutex);
+        if (mode == MS_BRLOCK) br_read_unlock(&br, id - 1);
+        else read_exit();
 
         sleep(1); // time between attempts
     }
@@ -47,40 +98,92 @@ void *librarian(void *arg) {
     while (1) {
         printf("[Librarian %d] wants to write.\n", id); fflush(stdout);
 
-        sem_wait(&wmutex);
-        writecount++;
-        if (writecount == 1) sem_wait(&readTry); // first writer blocks new readers
-        sem_post(&wmutex);
-
-        sem_wait(&resource); // exclusive access
+        if (mode == MS_BRLOCK) br_write_lock(&br);
+        else write_enter();
         printf("[Librarian %d] is WRITING.\n", id); fflush(stdout);
         sleep(1);
         manuscript++;
+        if (ms_optimistic(mode)) ms_publish(manuscript, id);
         printf("[Librarian %d] finished WRITING (new version %d).\n", id, manuscript); fflush(stdout);
-        sem_post(&resource);
-
-        sem_wait(&wmutex);
-        writecount--;
-        if (writecount == 0) sem_post(&readTry); // last writer allows readers
-        sem_post(&wmutex);
+        if (mode == MS_BRLOCK) br_write_unlock(&br);
+        else write_exit();
 
         sleep(1); // time between attempts
     }
     return NULL;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <#students> <#librarians>\n", argv[0]);
-        exit(EXIT_FAILURE);
-    }
-    num_students = atoi(argv[1]);
-    num_librarians = atoi(argv[2]);
+/* Read throughput of the writers-preference semaphores above, the big-reader lock with the
+   same policy, the seqlock and RCU (see ms_bench). */
+static int bench_read_sem(int reader) {
+    (void)reader;
+    read_enter();
+    int ok = manuscript >= 0;
+    read_exit();
+    return ok;
+}
 
+static int bench_read_br(int reader) {
+    br_read_lock(&br, reader);
+    int ok = manuscript >= 0;
+    br_read_unlock(&br, reader);
+    return ok;
+}
+
+static void bench_write_sem(void) {
+    write_enter();
+    manuscript++;
+    ms_publish(manuscript, 1);
+    write_exit();
+}
+
+static void bench_write_br(void) {
+    br_write_lock(&br);
+    manuscript++;
+    ms_publish(manuscript, 1);
+    br_write_unlock(&br);
+}
+
+int run_bench(int max_threads, int secs) {
+    static const ms_bench_mode modes[] = {
+        { "sem", bench_read_sem, bench_write_sem },
+        { "brlock", bench_read_br, bench_write_br },
+        { "seqlock", ms_bench_read_seqlock, bench_write_sem },
+        { "rcu", ms_bench_read_rcu, bench_write_sem },
+    };
+    if (br_init(&br, max_threads, BR_WRITERS_PREF) != 0) return 1;
+    long bad = ms_bench(modes, 4, max_threads, secs);
+    br_destroy(&br);
+    return bad == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
     sem_init(&resource, 0, 1);
     sem_init(&rmutex, 0, 1);
     sem_init(&readTry, 0, 1);
     sem_init(&wmutex, 0, 1);
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int max_threads = argc >= 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int secs = argc >= 4 ? atoi(argv[3]) : 1;
+        if (max_threads < 1 || max_threads > MS_MAX_READERS || secs < 1) {
+            fprintf(stderr, "Usage: %s bench [max_threads] [seconds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        return run_bench(max_threads, secs);
+    }
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <#students> <#librarians> [sem|seqlock|rcu|brlock]\n", argv[0]);
+        fprintf(stderr, "       %s bench [max_threads] [seconds]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    num_students = atoi(argv[1]);
+    num_librarians = atoi(argv[2]);
+    if (argc == 4 && (int)(mode = (ms_mode)ms_parse_mode(argv[3])) < 0) {
+        fprintf(stderr, "Unknown read mode %s\n", argv[3]);
+        exit(EXIT_FAILURE);
+    }
+    if (ms_optimistic(mode) && ms_init(num_students > 0 ? num_students : 1) != 0) exit(EXIT_FAILURE);
+    if (mode == MS_BRLOCK && br_init(&br, num_students > 0 ? num_students : 1, BR_WRITERS_PREF) != 0) exit(EXIT_FAILURE);
 
     pthread_t *stud = malloc(sizeof(pthread_t) * num_students);
     pthread_t *lib  = malloc(sizeof(pthread_t) * num_librarians);
@@ -103,6 +206,8 @@ int main(int argc, char *argv[]) {
     sem_destroy(&rmutex);
     sem_destroy(&readTry);
     sem_destroy(&wmutex);
+    if (ms_optimistic(mode)) ms_cleanup();
+    if (mode == MS_BRLOCK) br_destroy(&br);
     free(stud); free(lib);
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,8 @@
 // q3_fcfs_researcher.c
 // FCFS queue-based fairness with reader batching and Researchers (lowest priority).
-// Usage: ./q3_fcfs_researcher <#students> <#librarians> <#researchers> <#accesses>
+// Usage: ./q3_fcfs_researcher <#students> <#librarians> <#researchers> <#accesses> [sem|seqlock|rcu]
 // Each thread performs <#accesses> then exits (finite runs).
+// With seqlock or rcu, students read optimistically and skip the queue; writers keep FCFS order.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +10,7 @@
 #include <semaphore.h>
 #include <unistd.h>
 #include <string.h>
+#include "manuscript.h"
 
 typedef enum { READER, WRITER, RESEARCHER } ThreadType;
 
@@ -32,6 +34,7 @@ int readcount = 0;
 int manuscript = 0;
 
 int num_students, num_librarians, num_researchers, num_accesses;
+ms_mode mode = MS_SEM; // how students read: semaphores, seqlock snapshot or RCU document
 
 // Helper: enqueue node and (if becomes head) wake appropriate node(s)
 void enqueue_and_maybe_wake(Node *node) {
@@ -106,6 +109,24 @@ void *student(void *arg) {
     int id = *(int*)arg; free(arg);
 
     for (int iter = 0; iter < num_accesses; ++iter) {
+        if (mode == MS_SEQLOCK) {
+            ms_snapshot snap = ms_read_snapshot();
+            printf("[Student %d] START READING (version %d)\n", id, snap.version); fflush(stdout);
+            sleep(1);
+            printf("[Student %d] END READING\n", id); fflush(stdout);
+            sleep(1);
+            continue;
+        }
+        if (mode == MS_RCU) {
+            const ms_doc *doc = ms_rcu_enter(id - 1);
+            printf("[Student %d] START READING (version %d)\n", id, doc->version); fflush(stdout);
+            sleep(1);
+            printf("[Student %d] END READING\n", id); fflush(stdout);
+            ms_rcu_exit(id - 1);
+            sleep(1);
+            continue;
+        }
+
         // create node and enqueue
         Node *n = malloc(sizeof(Node));
         memset(n, 0, sizeof(Node));
@@ -165,6 +186,7 @@ void *librarian(void *arg) {
         printf("[Librarian %d] START WRITING\n", id); fflush(stdout);
         sleep(1);
         manuscript++;
+        if (ms_optimistic(mode)) ms_publish(manuscript, id);
         printf("[Librarian %d] END WRITING (new version %d)\n", id, manuscript); fflush(stdout);
         sem_post(&resource);
 
@@ -196,6 +218,7 @@ void *researcher(void *arg) {
         printf("[Researcher %d] START WRITING (RESEARCH)\n", id); fflush(stdout);
         sleep(1);
         manuscript++;
+        if (ms_optimistic(mode)) ms_publish(manuscript, -id);  // researchers publish with negative editor ids
         printf("[Researcher %d] END WRITING (RESEARCH) (new version %d)\n", id, manuscript); fflush(stdout);
         sem_post(&resource);
 
@@ -208,14 +231,19 @@ void *researcher(void *arg) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <#students> <#librarians> <#researchers> <#accesses>\n", argv[0]);
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: %s <#students> <#librarians> <#researchers> <#accesses> [sem|seqlock|rcu]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
     num_students = atoi(argv[1]);
     num_librarians = atoi(argv[2]);
     num_researchers = atoi(argv[3]);
     num_accesses = atoi(argv[4]);
+    if (argc == 6 && ((int)(mode = (ms_mode)ms_parse_mode(argv[5])) < 0 || mode == MS_BRLOCK)) {
+        fprintf(stderr, "Read mode %s not available here (sem, seqlock or rcu)\n", argv[5]);
+        exit(EXIT_FAILURE);
+    }
+    if (ms_optimistic(mode) && ms_init(num_students > 0 ? num_students : 1) != 0) exit(EXIT_FAILURE);
 
     sem_init(&resource, 0, 1);
 
@@ -246,6 +274,7 @@ int main(int argc, char *argv[]) {
 
     // cleanup
     sem_destroy(&resource);
+    if (ms_optimistic(mode)) ms_cleanup();
     free(students); free(librarians); free(researchers);
     return 0;
 }
\ No newline at end of file
@@ -1,175 +1,746 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <limits.h>
+#include <unistd.h>
 
+typedef enum { FIRST_FIT, BEST_FIT, NEXT_FIT, BUDDY, NUM_STRATEGIES } Strategy;
+static const char *strategy_name[NUM_STRATEGIES] = {"first", "best", "next", "buddy"};
+
+/* Blocks live in a treap ordered by start address. Each node also records the largest
+   free block in its subtree, so first fit, coalescing and largest_free are O(log n). */
 typedef struct Block {
     int start;
     int size;
     int allocated;
     int id;
-    struct Block *next;
+    int max_free;
+    unsigned prio;
+    struct Block *left, *right;
 } Block;
 
+static Block **by_id;     // allocation id -> its block
+static long long free_total;
+static long long internal_frag;   // allocated minus requested, buddy only
+static int next_fit_rover;
+
+// compaction: when an allocation fails although enough memory is free in total
+static int compaction_on;
+static long long compaction_budget;   // KB moved per pass, 0 = unbounded
+static long long moved_total, compactions, rescued, last_moved, max_pass_moved;
+
+static unsigned next_prio(void) {
+    static unsigned x = 2463534242u;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return x;
+}
+
+/* Block nodes come from a pool grown in chunks; released nodes go on a free list
+   linked through `right`, so splits and merges never call malloc/free. */
+#define POOL_CHUNK 4096
+static Block *pool_free;
+static Block **pool_chunks;
+static int pool_nchunks, pool_cap;
+
+static Block* block_get(void) {
+    if (!pool_free) {
+        if (pool_nchunks == pool_cap) {
+            pool_cap = pool_cap ? pool_cap * 2 : 16;
+            pool_chunks = realloc(pool_chunks, sizeof(Block*) * pool_cap);
+        }
+        Block *c = malloc(sizeof(Block) * POOL_CHUNK);
+        pool_chunks[pool_nchunks++] = c;
+        for (int i = 0; i < POOL_CHUNK; i++) {
+            c[i].right = pool_free;
+            pool_free = &c[i];
+        }
+    }
+    Block *b = pool_free;
+    pool_free = b->right;
+    return b;
+}
+
+static void block_put(Block *b) {
+    b->right = pool_free;
+    pool_free = b;
+}
+
+static void pool_destroy(void) {
+    for (int i = 0; i < pool_nchunks; i++) free(pool_chunks[i]);
+    free(pool_chunks);
+    pool_chunks = NULL;
+    pool_free = NULL;
+    pool_nchunks = pool_cap = 0;
+}
+
 Block* make_block(int start, int size, int allocated, int id) {
-    Block *b = malloc(sizeof(Block));
+    Block *b = block_get();
     b->start = start;
     b->size = size;
     b->allocated = allocated;
     b->id = id;
-    b->next = NULL;
+    b->max_free = allocated ? 0 : size;
+    b->prio = next_prio();
+    b->left = b->right = NULL;
     return b;
 }
 
-void print_blocks(Block *head) {
-    Block *p = head;
+static void pull(Block *t) {
+    int m = t->allocated ? 0 : t->size;
+    if (t->left && t->left->max_free > m) m = t->left->max_free;
+    if (t->right && t->right->max_free > m) m = t->right->max_free;
+    t->max_free = m;
+}
+
+static Block* rotate_right(Block *t) {
+    Block *l = t->left;
+    t->left = l->right;
+    l->right = t;
+    pull(t); pull(l);
+    return l;
+}
+
+static Block* rotate_left(Block *t) {
+    Block *r = t->right;
+    t->right = r->left;
+    r->left = t;
+    pull(t); pull(r);
+    return r;
+}
+
+Block* insert_block(Block *t, Block *b) {
+    if (!t) return b;
+    if (b->start < t->start) {
+        t->left = insert_block(t->left, b);
+        if (t->left->prio > t->prio) return rotate_right(t);
+    }
+
+    else {
+        t->right = insert_block(t->right, b);
+        if (t->right->prio > t->prio) return rotate_left(t);
+    }
+    pull(t);
+    return t;
+}
+
+static Block* join(Block *a, Block *b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (a->prio > b->prio) { a->right = join(a->right, b); pull(a); return a; }
+    b->left = join(a, b->left); pull(b); return b;
+}
+
+// unlinks the node starting at `start`; the caller owns (and frees) it
+Block* erase_block(Block *t, int start) {
+    if (!t) return NULL;
+    if (start < t->start) t->left = erase_block(t->left, start);
+    else if (start > t->start) t->right = erase_block(t->right, start);
+    else return join(t->left, t->right);
+    pull(t);
+    return t;
+}
+
+// recomputes max_free on the path to `start` after that block changed
+void refresh(Block *t, int start) {
+    if (!t) return;
+    if (start < t->start) refresh(t->left, start);
+    else if (start > t->start) refresh(t->right, start);
+    pull(t);
+}
+
+Block* prev_block(Block *t, int start) {
+    Block *best = NULL;
+    while (t) {
+        if (t->start < start) { best = t; t = t->right; }
+        else t = t->left;
+    }
+    return best;
+}
+
+Block* next_block(Block *t, int start) {
+    Block *best = NULL;
+    while (t) {
+        if (t->start > start) { best = t; t = t->left; }
+        else t = t->right;
+    }
+    return best;
+}
+
+static void print_tree(Block *t) {
+    if (!t) return;
+    print_tree(t->left);
+    if (t->allocated) printf("[Alloc id=%d size=%d] ", t->id, t->size);
+    else printf("[Free size=%d] ", t->size);
+    print_tree(t->right);
+}
+
+void print_blocks(Block *root) {
     printf("Memory map:\n");
-    while (p) {
-        if (p->allocated) printf("[Alloc id=%d size=%d] ", p->id, p->size);
-        else printf("[Free size=%d] ", p->size);
+    print_tree(root);
+    printf("\n");
+}
+
+// lowest-address free block with size >= size, found by following max_free
+Block* find_first_fit(Block *t, int size) {
+    while (t) {
+        if (t->left && t->left->max_free >= size) t = t->left;
+        else if (!t->allocated && t->size >= size) return t;
+        else if (t->right && t->right->max_free >= size) t = t->right;
+        else return NULL;
+    }
+    return NULL;
+}
+
+// smallest free block with size >= size (lowest address on ties), pruned by max_free
+static void best_fit_search(Block *t, int size, Block **best) {
+    if (!t || t->max_free < size) return;
+    if (*best && (*best)->size == size) return;
+    best_fit_search(t->left, size, best);
+    if (!t->allocated && t->size >= size && (!*best || t->size < (*best)->size)) *best = t;
+    best_fit_search(t->right, size, best);
+}
+
+Block* find_best_fit(Block *t, int size) {
+    Block *best = NULL;
+    best_fit_search(t, size, &best);
+    return best;
+}
+
+// first fit among blocks starting at or after `from`
+static Block* first_fit_from(Block *t, int size, int from) {
+    if (!t || t->max_free < size) return NULL;
+    if (t->start < from) return first_fit_from(t->right, size, from);
+    Block *r = first_fit_from(t->left, size, from);
+    if (r) return r;
+    if (!t->allocated && t->size >= size) return t;
+    return find_first_fit(t->right, size);
+}
+
+// first fit resuming where the previous allocation ended, wrapping to the start
+Block* find_next_fit(Block *t, int size) {
+    Block *p = first_fit_from(t, size, next_fit_rover);
+    return p ? p : find_first_fit(t, size);
+}
+
+static int allocate_in(Block **root, Block *p, int size, int alloc_id) {
+    if (!p) return 0;
+    if (p->size > size) {
+        Block *newb = make_block(p->start + size, p->size - size, 0, -1);
+        p->size = size;
+        *root = insert_block(*root, newb);
+    }
+    p->allocated = 1;
+    p->id = alloc_id;
+    refresh(*root, p->start);
+    by_id[alloc_id] = p;
+    free_total -= size;
+    next_fit_rover = p->start + size;
+    return 1;
+}
+
+int allocate_first_fit(Block **root, int size, int alloc_id) {
+    return allocate_in(root, find_first_fit(*root, size), size, alloc_id);
+}
+
+int allocate_best_fit(Block **root, int size, int alloc_id) {
+    return allocate_in(root, find_best_fit(*root, size), size, alloc_id);
+}
+
+int allocate_next_fit(Block **root, int size, int alloc_id) {
+    return allocate_in(root, find_next_fit(*root, size), size, alloc_id);
+}
 
-        p = p->next;
+void deallocate(Block **root, int alloc_id) {
+    Block *p = by_id[alloc_id];
+    if (!p) return;
+    by_id[alloc_id] = NULL;
+    p->allocated = 0;
+    p->id = -1;
+    free_total += p->size;
+
+    Block *n = next_block(*root, p->start);
+    if (n && !n->allocated) {
+        p->size += n->size;
+        *root = erase_block(*root, n->start);
+        block_put(n);
+    }
+    Block *q = prev_block(*root, p->start);
+    if (q && !q->allocated) {
+        q->size += p->size;
+        *root = erase_block(*root, p->start);
+        block_put(p);
+        p = q;
+    }
+    refresh(*root, p->start);
+}
+
+long long total_free(Block *root) {
+    (void)root;
+    return free_total;
+}
+
+int largest_free(Block *root) {
+    return root ? root->max_free : 0;
+}
+
+/* Binary buddy allocator in 1 KB units. Memory is seeded as its binary decomposition
+   (largest power of two first), so a tail block whose buddy lies past the end never merges.
+   Free blocks of each order sit on a doubly-linked list indexed by offset; one bit per
+   buddy pair and order is set while exactly one of the two buddies is free. */
+static int buddy_max_order;
+static int *bfl_head;              // per order, first free offset or -1
+static int *bfl_next, *bfl_prev;   // free-list links, indexed by block offset
+static unsigned char **buddy_bits;
+static int *buddy_off, *buddy_req; // per allocation id, sized with by_id
+static unsigned char *buddy_ord;
+static int id_cap;
+static long long buddy_free;
+
+static void bfl_push(int o, int off) {
+    bfl_prev[off] = -1;
+    bfl_next[off] = bfl_head[o];
+    if (bfl_head[o] >= 0) bfl_prev[bfl_head[o]] = off;
+    bfl_head[o] = off;
+}
+
+static void bfl_remove(int o, int off) {
+    if (bfl_prev[off] >= 0) bfl_next[bfl_prev[off]] = bfl_next[off];
+    else bfl_head[o] = bfl_next[off];
+    if (bfl_next[off] >= 0) bfl_prev[bfl_next[off]] = bfl_prev[off];
+}
+
+// flips the pair bit of the block at (o, off); returns the new value
+static int buddy_toggle(int o, int off) {
+    if (o == buddy_max_order) return 0;
+    int pair = off >> (o + 1);
+    buddy_bits[o][pair >> 3] ^= 1 << (pair & 7);
+    return (buddy_bits[o][pair >> 3] >> (pair & 7)) & 1;
+}
+
+// grows every id-indexed table so that `id` is a valid index
+static void ensure_ids(int id) {
+    if (id < id_cap) return;
+    int cap = id_cap ? id_cap : 1024;
+    while (cap <= id) cap *= 2;
+    by_id = realloc(by_id, sizeof(Block*) * cap);
+    memset(by_id + id_cap, 0, sizeof(Block*) * (cap - id_cap));
+    buddy_off = realloc(buddy_off, sizeof(int) * cap);
+    buddy_req = realloc(buddy_req, sizeof(int) * cap);
+    buddy_ord = realloc(buddy_ord, cap);
+    id_cap = cap;
+}
+
+void buddy_init(int total_mem) {
+    buddy_max_order = 0;
+    while ((2LL << buddy_max_order) <= total_mem) buddy_max_order++;
+    int units = 2 << buddy_max_order;
+    bfl_head = malloc(sizeof(int) * (buddy_max_order + 1));
+    bfl_next = malloc(sizeof(int) * units);
+    bfl_prev = malloc(sizeof(int) * units);
+    buddy_bits = malloc(sizeof(unsigned char*) * (buddy_max_order + 1));
+    for (int o = 0; o <= buddy_max_order; o++) {
+        bfl_head[o] = -1;
+        buddy_bits[o] = calloc((units >> (o + 1)) / 8 + 1, 1);
+    }
+    int off = 0;
+    for (int o = buddy_max_order; o >= 0; o--) {
+        if (total_mem - off < (1 << o)) continue;
+        bfl_push(o, off);
+        buddy_toggle(o, off);
+        off += 1 << o;
+    }
+    buddy_free = total_mem;
+    internal_frag = 0;
+}
+
+void buddy_destroy(void) {
+    for (int o = 0; o <= buddy_max_order; o++) free(buddy_bits[o]);
+    free(buddy_bits); free(bfl_head); free(bfl_next); free(bfl_prev);
+}
+
+int buddy_alloc(int size, int alloc_id) {
+    int o = 0;
+    while ((1LL << o) < size) o++;
+    int j = o;
+    while (j <= buddy_max_order && bfl_head[j] < 0) j++;
+    if (j > buddy_max_order) return 0;
+
+    int off = bfl_head[j];
+    bfl_remove(j, off);
+    buddy_toggle(j, off);
+    while (j > o) {
+        j--;
+        bfl_push(j, off + (1 << j));
+        buddy_toggle(j, off + (1 << j));
+    }
+    buddy_off[alloc_id] = off;
+    buddy_ord[alloc_id] = (unsigned char)o;
+    buddy_req[alloc_id] = size;
+    buddy_free -= 1 << o;
+    internal_frag += (1 << o) - size;
+    return 1;
+}
+
+void buddy_release(int alloc_id) {
+    int off = buddy_off[alloc_id], o = buddy_ord[alloc_id];
+    buddy_free += 1 << o;
+    internal_frag -= (1 << o) - buddy_req[alloc_id];
+    // a cleared pair bit after our toggle means the buddy is free too: merge upwards
+    while (o < buddy_max_order && !buddy_toggle(o, off)) {
+        bfl_remove(o, off ^ (1 << o));
+        off &= ~(1 << o);
+        o++;
+    }
+    bfl_push(o, off);
+}
+
+int buddy_largest_free(void) {
+    for (int o = buddy_max_order; o >= 0; o--)
+        if (bfl_head[o] >= 0) return 1 << o;
+    return 0;
+}
+
+void print_buddy(void) {
+    printf("Buddy free lists:");
+    for (int o = 0; o <= buddy_max_order; o++) {
+        int n = 0;
+        for (int off = bfl_head[o]; off >= 0; off = bfl_next[off]) n++;
+        if (n) printf(" [%d KB x%d]", 1 << o, n);
     }
     printf("\n");
 }
 
-void merge_free(Block *head) {
-    Block *p = head;
-    while (p && p->next) {
-        if (!p->allocated && !p->next->allocated) {
-            p->size += p->next->size;
-            Block *tmp = p->next;
-            p->next = tmp->next;
-            free(tmp);
-        } 
-        
-        else p = p->next;
+/* Slides allocated blocks down into the hole just below them, one block at a time, until a
+   free block of `need` KB exists or nothing more can move. With a budget a pass moves at most
+   `budget` KB: each move takes the first block in address order that follows a hole and still
+   fits in what is left, so a block larger than the budget is skipped rather than stalling the
+   pass or overrunning it. A move swaps the contents of the hole node and the block node, which
+   keeps the address order of the tree, and repoints the block's id handle. Returns KB moved. */
+long long compact(Block **root, int need, long long budget) {
+    long long moved = 0;
+    while (largest_free(*root) < need) {
+        long long room = budget > 0 ? budget - moved : LLONG_MAX;
+        Block *hole = find_first_fit(*root, 1), *b = NULL;
+        while (hole) {
+            b = next_block(*root, hole->start);
+            if (!b || b->size <= room) break;
+            hole = b;   // too large for the rest of the budget: try the next hole
+            do hole = next_block(*root, hole->start); while (hole && hole->allocated);
+        }
+        if (!hole || !b) break;
+
+        int hole_size = hole->size;
+        hole->allocated = 1;
+        hole->id = b->id;
+        hole->size = b->size;
+        by_id[b->id] = hole;
+        moved += b->size;
+
+        b->start = hole->start + hole->size;
+        b->allocated = 0;
+        b->id = -1;
+        b->size = hole_size;
+        Block *n = next_block(*root, b->start);
+        if (n && !n->allocated) {
+            b->size += n->size;
+            *root = erase_block(*root, n->start);
+            block_put(n);
+        }
+        refresh(*root, hole->start);
+        refresh(*root, b->start);
     }
+    compactions++;
+    moved_total += moved;
+    if (moved > max_pass_moved) max_pass_moved = moved;
+    return moved;
 }
 
-int allocate_first_fit(Block *head, int size, int alloc_id) {
-    Block *p = head;
-    while (p) {
-        if (!p->allocated && p->size >= size) {
-            if (p->size == size) {
-                p->allocated = 1;
-                p->id = alloc_id;
-            } 
-            
-            else {
-                Block *newb = make_block(p->start + size, p->size - size, 0, -1);
-                newb->next = p->next;
-                p->next = newb;
-                p->size = size;
-                p->allocated = 1;
-                p->id = alloc_id;
-            }
-            return 1;
+static int allocate_fit(Strategy s, Block **root, int size, int alloc_id) {
+    switch (s) {
+        case BEST_FIT: return allocate_best_fit(root, size, alloc_id);
+        case NEXT_FIT: return allocate_next_fit(root, size, alloc_id);
+        default: return allocate_first_fit(root, size, alloc_id);
+    }
+}
+
+int allocate(Strategy s, Block **root, int size, int alloc_id) {
+    ensure_ids(alloc_id);
+    if (s == BUDDY) return buddy_alloc(size, alloc_id);
+    int ok = allocate_fit(s, root, size, alloc_id);
+    last_moved = 0;
+    if (!ok && compaction_on && free_total >= size) {
+        last_moved = compact(root, size, compaction_budget);
+        if (largest_free(*root) >= size) {
+            ok = allocate_fit(s, root, size, alloc_id);
+            rescued++;
         }
-        p = p->next;
     }
-    return 0;
+    return ok;
+}
+
+void release(Strategy s, Block **root, int alloc_id) {
+    if (s == BUDDY) buddy_release(alloc_id);
+    else deallocate(root, alloc_id);
+}
+
+long long strategy_free(Strategy s, Block *root) { return s == BUDDY ? buddy_free : total_free(root); }
+int strategy_largest(Strategy s, Block *root) { return s == BUDDY ? buddy_largest_free() : largest_free(root); }
+
+void memory_init(Strategy s, Block **root, int total_mem) {
+    *root = make_block(0, total_mem, 0, -1);
+    free_total = total_mem;
+    internal_frag = 0;
+    next_fit_rover = 0;
+    moved_total = compactions = rescued = max_pass_moved = 0;
+    ensure_ids(1);
+    if (s == BUDDY) buddy_init(total_mem);
+}
+
+void memory_destroy(Strategy s) {
+    free(by_id); free(buddy_off); free(buddy_req); free(buddy_ord);
+    by_id = NULL; buddy_off = buddy_req = NULL; buddy_ord = NULL;
+    id_cap = 0;
+    pool_destroy();
+    if (s == BUDDY) buddy_destroy();
+}
+
+/* Live allocation ids. A random pick removes by swapping in the last id, so both are O(1).
+   With `reuse` set, released ids are handed out again and id-indexed tables stay as
+   small as the peak number of live blocks. */
+typedef struct {
+    int *live, *spare;
+    int count, nspare, cap, next, reuse;
+} IdSet;
+
+void idset_init(IdSet *ids, int reuse) {
+    memset(ids, 0, sizeof(*ids));
+    ids->next = 1;
+    ids->reuse = reuse;
+}
+
+// the id the next successful allocation will take
+int idset_next(IdSet *ids) {
+    return ids->nspare ? ids->spare[ids->nspare - 1] : ids->next;
 }
 
-void deallocate(Block *head, int alloc_id) {
-    Block *p = head;
-    while (p) {
-        if (p->allocated && p->id == alloc_id) {
-            p->allocated = 0;
-            p->id = -1;
-            break;
+void idset_add(IdSet *ids, int id) {
+    if (ids->nspare && ids->spare[ids->nspare - 1] == id) ids->nspare--;
+    else ids->next++;
+    if (ids->count == ids->cap) {
+        ids->cap = ids->cap ? ids->cap * 2 : 1024;
+        ids->live = realloc(ids->live, sizeof(int) * ids->cap);
+        ids->spare = realloc(ids->spare, sizeof(int) * ids->cap);
+    }
+    ids->live[ids->count++] = id;
+}
+
+int idset_remove(IdSet *ids, int idx) {
+    int id = ids->live[idx];
+    ids->live[idx] = ids->live[--ids->count];
+    if (ids->reuse) ids->spare[ids->nspare++] = id;
+    return id;
+}
+
+void idset_free(IdSet *ids) {
+    free(ids->live);
+    free(ids->spare);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    long long failed;
+    double ratio_sum, secs;
+} RunStats;
+
+/* Silent run of `num_ops` random operations. Every op draws the same three numbers, so a
+   seed gives the same op stream to every strategy. Prints a summary line every
+   `report_every` ops when that is positive, and leaves the final memory state in *root. */
+RunStats run_batch(Strategy s, Block **root, int total_mem, long long num_ops, unsigned seed,
+                   long long report_every) {
+    RunStats st = {0, 0, 0};
+    IdSet ids;
+    idset_init(&ids, 1);
+    memory_init(s, root, total_mem);
+    srand(seed);
+    int max_size = total_mem / 2;
+    if (max_size < 1) max_size = total_mem;
+
+    double t0 = now_sec();
+    for (long long op = 1; op <= num_ops; op++) {
+        int coin = rand() % 2;
+        int size = (rand() % max_size) + 1;
+        int pick = rand();
+        if (ids.count == 0 || coin) {
+            int id = idset_next(&ids);
+            if (allocate(s, root, size, id)) idset_add(&ids, id);
+            else st.failed++;
+        }
+
+        else release(s, root, idset_remove(&ids, pick % ids.count));
+
+        long long fr = strategy_free(s, *root);
+        int largest = strategy_largest(s, *root);
+        if (fr) st.ratio_sum += (double)(fr - largest) / fr;
+        if (report_every > 0 && op % report_every == 0) {
+            double secs = now_sec() - t0;
+            printf("op %lld: live %d | free %lld KB | largest %d KB | ext frag %.3f | failed %lld | %.2f Mops/s\n",
+                   op, ids.count, fr, largest, fr ? (double)(fr - largest) / fr : 0.0, st.failed,
+                   op / (secs > 0 ? secs : 1e-9) / 1e6);
         }
-        p = p->next;
     }
-    merge_free(head);
+    st.secs = now_sec() - t0;
+    idset_free(&ids);
+    return st;
 }
 
-int total_free(Block *head) {
-    int sum = 0;
-    Block *p = head;
-    while (p) {
-        if (!p->allocated) sum += p->size;
-        p = p->next;
+/* Runs every strategy on the op stream of one seed and prints a comparison. */
+int run_compare(int total_mem, long long num_ops, unsigned seed) {
+    printf("\nStrategy | Failed allocs | Internal frag | External frag | Frag ratio | Mean ratio | Ops/sec  | Moved KB | Rescued\n");
+    printf("---------+---------------+---------------+---------------+------------+------------+----------+----------+--------\n");
+    for (Strategy s = 0; s < NUM_STRATEGIES; s++) {
+        Block *root;
+        RunStats st = run_batch(s, &root, total_mem, num_ops, seed, 0);
+        long long fr = strategy_free(s, root);
+        long long ext = fr - strategy_largest(s, root);
+        printf(" %-7s | %13lld | %10lld KB | %10lld KB | %10.3f | %10.3f | %8.0f | %8lld | %7lld\n",
+               strategy_name[s], st.failed, internal_frag, ext, fr ? (double)ext / fr : 0.0,
+               st.ratio_sum / num_ops, num_ops / (st.secs > 0 ? st.secs : 1e-9), moved_total, rescued);
+        memory_destroy(s);
     }
-    return sum;
+    return 0;
 }
 
-int largest_free(Block *head) {
-    int mx = 0;
-    Block *p = head;
-    while (p) {
-        if (!p->allocated && p->size > mx) mx = p->size;
-        p = p->next;
+void print_summary(Strategy strategy, Block *root) {
+    long long totalfree = strategy_free(strategy, root);
+    int largest = strategy_largest(strategy, root);
+    long long external_frag = totalfree - largest;
+    double frag_ratio = totalfree == 0 ? 0.0 : (double)external_frag / totalfree;
+
+    printf("\nFinal Summary:\n");
+    printf("Total free space: %lld KB\n", totalfree);
+    printf("Largest contiguous free block: %d KB\n", largest);
+    printf("External fragmentation: %lld KB\n", external_frag);
+    printf("Fragmentation ratio: %.3f\n", frag_ratio);
+    if (strategy == BUDDY) printf("Internal fragmentation: %lld KB\n", internal_frag);
+    if (compaction_on) {
+        printf("Compaction: %lld passes, %lld KB moved, %lld allocations rescued\n",
+               compactions, moved_total, rescued);
+        printf("Per pass: mean %.1f KB, max %lld KB moved", compactions ? (double)moved_total / compactions : 0.0,
+               max_pass_moved);
+        if (compaction_budget > 0) printf(" (budget %lld KB)\n", compaction_budget);
+        else printf(" (no budget)\n");
     }
-    return mx;
 }
 
-int main() {
-    srand(time(NULL));
-    int total_mem, num_ops;
-    printf("Enter total memory size (KB): ");
-    if (scanf("%d", &total_mem) != 1) return 0;
+int main(int argc, char **argv) {
+    Strategy strategy = FIRST_FIT;
+    int compare = 0, opt;
+    int total_mem = -1;
+    long long num_ops = -1, report_every = -1;
+    unsigned seed = (unsigned)time(NULL);
+    const char *usage = "Usage: %s [-c] [-b budget_kb] [-m memory_kb] [-n ops] [-s seed] [-r report_every]"
+                        " [first|best|next|buddy|compare]\n"
+                        "       -n runs in batch mode: no prompts, no per-operation trace\n";
+    while ((opt = getopt(argc, argv, "cb:m:n:s:r:")) != -1) {
+        switch (opt) {
+            case 'c': compaction_on = 1; break;
+            case 'b': compaction_on = 1; compaction_budget = atoll(optarg); break;
+            case 'm': total_mem = atoi(optarg); break;
+            case 'n': num_ops = atoll(optarg); break;
+            case 's': seed = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'r': report_every = atoll(optarg); break;
+            default: fprintf(stderr, usage, argv[0]); return 1;
+        }
+    }
+    if (optind < argc) {
+        if (strcmp(argv[optind], "compare") == 0) compare = 1;
+        else {
+            for (strategy = 0; strategy < NUM_STRATEGIES; strategy++)
+                if (strcmp(argv[optind], strategy_name[strategy]) == 0) break;
+            if (strategy == NUM_STRATEGIES) {
+                fprintf(stderr, usage, argv[0]);
+                return 1;
+            }
+        }
+    }
+    int batch = num_ops >= 0;
+    srand(seed);
+    if (total_mem < 0) {
+        printf("Enter total memory size (KB): ");
+        if (scanf("%d", &total_mem) != 1) return 0;
+    }
+
+    if (num_ops < 0) {
+        printf("Enter number of operations: ");
+        if (scanf("%lld", &num_ops) != 1) return 0;
+    }
+    if (total_mem < 1 || num_ops < 1) { fprintf(stderr, usage, argv[0]); return 1; }
+    if (compare) return run_compare(total_mem, num_ops, seed);
 
-    printf("Enter number of operations: ");
-    if (scanf("%d", &num_ops) != 1) return 0;
+    Block *root;
+    if (batch) {
+        if (report_every < 0) report_every = num_ops >= 10 ? num_ops / 10 : 1;
+        printf("Batch: %s%s, %d KB, %lld operations, seed %u\n", strategy_name[strategy],
+               strategy == BUDDY ? "" : " fit", total_mem, num_ops, seed);
+        RunStats st = run_batch(strategy, &root, total_mem, num_ops, seed, report_every);
+        print_summary(strategy, root);
+        printf("Failed allocations: %lld | Mean fragmentation ratio: %.3f | %.2f Mops/s\n",
+               st.failed, st.ratio_sum / num_ops, num_ops / (st.secs > 0 ? st.secs : 1e-9) / 1e6);
+        memory_destroy(strategy);
+        if (compaction_budget > 0 && max_pass_moved > compaction_budget) {
+            fprintf(stderr, "Compaction moved %lld KB in one pass, over the %lld KB budget\n",
+                    max_pass_moved, compaction_budget);
+            return 1;
+        }
+        return 0;
+    }
 
-    Block *head = make_block(0, total_mem, 0, -1);
-    int next_alloc_id = 1;
-    int *allocated_ids = malloc(sizeof(int) * num_ops);
-    int allocated_count = 0;
+    memory_init(strategy, &root, total_mem);
+    IdSet ids;
+    idset_init(&ids, 0);
 
     printf("\nOperations:\n");
     for (int op = 1; op <= num_ops; op++) {
         int do_alloc;
 
-        if (allocated_count == 0) do_alloc = 1;
+        if (ids.count == 0) do_alloc = 1;
         else do_alloc = rand() % 2;
 
         if (do_alloc) {
             int max_size = total_mem / 2;
             if (max_size < 1) max_size = total_mem;
             int size = (rand() % max_size) + 1;
+            int next_alloc_id = idset_next(&ids);
 
             printf("Operation %d: Allocate %d KB -> ", op, size);
-            int ok = allocate_first_fit(head, size, next_alloc_id);
+            int ok = allocate(strategy, &root, size, next_alloc_id);
 
             if (ok) {
+                if (last_moved) printf("Compacted %lld KB, ", last_moved);
                 printf("Allocated as id %d\n", next_alloc_id);
-                allocated_ids[allocated_count++] = next_alloc_id;
-                next_alloc_id++;
+                idset_add(&ids, next_alloc_id);
             } 
             
             else printf("Allocation failed\n");
         } 
         
         else {
-            int idx = rand() % allocated_count;
-            int aid = allocated_ids[idx];
+            int aid = idset_remove(&ids, rand() % ids.count);
             printf("Operation %d: Deallocate block %d -> ", op, aid);
-            deallocate(head, aid);
-            for (int k = idx; k < allocated_count - 1; k++)
-                allocated_ids[k] = allocated_ids[k + 1];
-            allocated_count--;
+            release(strategy, &root, aid);
             printf("Done\n");
         }
-        print_blocks(head);
+        if (strategy == BUDDY) print_buddy();
+        else print_blocks(root);
     }
 
-    int totalfree = total_free(head);
-    int largest = largest_free(head);
-    int external_frag = totalfree - largest;
-    double frag_ratio = totalfree == 0 ? 0.0 : (double)external_frag / totalfree;
-
-    printf("\nFinal Summary:\n");
-    printf("Total free space: %d KB\n", totalfree);
-    printf("Largest contiguous free block: %d KB\n", largest);
-    printf("External fragmentation: %d KB\n", external_frag);
-    printf("Fragmentation ratio: %.3f\n", frag_ratio);
-
-    free(allocated_ids);
-    Block *p = head;
-    while (p) {
-        Block *q = p->next;
-        free(p);
-        p = q;
-    }
-}
\ No newline at end of file
+    print_summary(strategy, root);
+    idset_free(&ids);
+    memory_destroy(strategy);
+}
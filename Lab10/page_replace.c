@@ -1,34 +1,190 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #define PAGE_RANGE 10
 #define REF_LEN 30
 
+#define VPN_BITS 36              // 48-bit virtual addresses, 4 KB pages
+#define RADIX_BITS 9             // 512 entries per level, 4 levels
+#define RADIX_LEVELS 4
+#define NO_FRAME UINT32_MAX
+
 int rand_ref[REF_LEN];
 
+static uint64_t page_key(uint32_t pid, uint64_t vpn) { return ((uint64_t)pid << VPN_BITS) | vpn; }
+static uint64_t hash64(uint64_t k) { k ^= k >> 33; k *= 0xff51afd7ed558ccdULL; k ^= k >> 33; return k; }
+
+static size_t pow2_at_least(size_t n) {
+    size_t c = 1;
+    while (c < n) c <<= 1;
+    return c;
+}
+
+/* Inverted page table: one entry per physical frame, found through a hash anchor
+   table keyed by (pid, vpn). Entries of one bucket are chained by frame number. */
+typedef struct {
+    uint64_t key;
+    uint32_t next;
+    uint32_t used;
+} IptEntry;
+
+typedef struct {
+    IptEntry *e;
+    uint32_t *anchor;
+    size_t frames, mask;
+} InvertedPT;
+
+void ipt_init(InvertedPT *t, size_t frames) {
+    t->frames = frames;
+    t->e = calloc(frames, sizeof(IptEntry));
+    size_t buckets = pow2_at_least(frames);
+    t->mask = buckets - 1;
+    t->anchor = malloc(buckets * sizeof(uint32_t));
+    for (size_t i = 0; i < buckets; i++) t->anchor[i] = NO_FRAME;
+}
+
+uint32_t ipt_lookup(InvertedPT *t, uint32_t pid, uint64_t vpn) {
+    uint64_t key = page_key(pid, vpn);
+    uint32_t f = t->anchor[hash64(key) & t->mask];
+    while (f != NO_FRAME && t->e[f].key != key) f = t->e[f].next;
+    return f;
+}
+
+void ipt_map(InvertedPT *t, uint32_t frame, uint32_t pid, uint64_t vpn) {
+    uint64_t key = page_key(pid, vpn);
+    uint32_t *head = &t->anchor[hash64(key) & t->mask];
+    t->e[frame].key = key;
+    t->e[frame].used = 1;
+    t->e[frame].next = *head;
+    *head = frame;
+}
+
+void ipt_unmap(InvertedPT *t, uint32_t frame) {
+    if (!t->e[frame].used) return;
+    uint32_t *p = &t->anchor[hash64(t->e[frame].key) & t->mask];
+    while (*p != frame) p = &t->e[*p].next;
+    *p = t->e[frame].next;
+    t->e[frame].used = 0;
+}
+
+size_t ipt_bytes(InvertedPT *t) { return t->frames * sizeof(IptEntry) + (t->mask + 1) * sizeof(uint32_t); }
+void ipt_free(InvertedPT *t) { free(t->e); free(t->anchor); }
+
+/* Hashed page table with open addressing (linear probing), kept at most half full. */
+typedef struct {
+    uint64_t key;
+    uint32_t frame;
+} HptSlot;
+
+typedef struct {
+    HptSlot *s;
+    size_t cap, mask, count;
+} HashedPT;
+
+#define HPT_EMPTY UINT64_MAX
+
+void hpt_init(HashedPT *t, size_t expected) {
+    t->cap = pow2_at_least(expected * 2 < 16 ? 16 : expected * 2);
+    t->mask = t->cap - 1;
+    t->count = 0;
+    t->s = malloc(t->cap * sizeof(HptSlot));
+    for (size_t i = 0; i < t->cap; i++) t->s[i].key = HPT_EMPTY;
+}
+
+uint32_t hpt_lookup(HashedPT *t, uint32_t pid, uint64_t vpn) {
+    uint64_t key = page_key(pid, vpn);
+    for (size_t i = hash64(key) & t->mask;; i = (i + 1) & t->mask) {
+        if (t->s[i].key == key) return t->s[i].frame;
+        if (t->s[i].key == HPT_EMPTY) return NO_FRAME;
+    }
+}
+
+void hpt_map(HashedPT *t, uint32_t pid, uint64_t vpn, uint32_t frame) {
+    uint64_t key = page_key(pid, vpn);
+    size_t i = hash64(key) & t->mask;
+    while (t->s[i].key != HPT_EMPTY && t->s[i].key != key) i = (i + 1) & t->mask;
+    if (t->s[i].key == HPT_EMPTY) t->count++;
+    t->s[i].key = key;
+    t->s[i].frame = frame;
+}
+
+size_t hpt_bytes(HashedPT *t) { return t->cap * sizeof(HptSlot); }
+void hpt_free(HashedPT *t) { free(t->s); }
+
+/* Four-level radix table, x86-64 style: each node is one 4 KB page of 512 slots. */
+typedef struct {
+    void **root;
+    size_t nodes;
+} RadixPT;
+
+void radix_init(RadixPT *t) {
+    t->root = calloc(1 << RADIX_BITS, sizeof(void*));
+    t->nodes = 1;
+}
+
+uint32_t radix_lookup(RadixPT *t, uint64_t vpn) {
+    void **n = t->root;
+    for (int l = RADIX_LEVELS - 1; l > 0; l--) {
+        n = n[(vpn >> (l * RADIX_BITS)) & ((1 << RADIX_BITS) - 1)];
+        if (!n) return NO_FRAME;
+    }
+    uint32_t *leaf = (uint32_t*)n;
+    return leaf[vpn & ((1 << RADIX_BITS) - 1)];
+}
+
+void radix_map(RadixPT *t, uint64_t vpn, uint32_t frame) {
+    void **n = t->root;
+    for (int l = RADIX_LEVELS - 1; l > 0; l--) {
+        void **slot = &n[(vpn >> (l * RADIX_BITS)) & ((1 << RADIX_BITS) - 1)];
+        if (!*slot) {
+            if (l > 1) *slot = calloc(1 << RADIX_BITS, sizeof(void*));
+            else {
+                uint32_t *leaf = malloc((1 << RADIX_BITS) * sizeof(uint64_t));
+                for (int k = 0; k < 1 << RADIX_BITS; k++) leaf[k] = NO_FRAME;
+                *slot = leaf;
+            }
+            t->nodes++;
+        }
+        n = *slot;
+    }
+    ((uint32_t*)n)[vpn & ((1 << RADIX_BITS) - 1)] = frame;
+}
+
+static void radix_free_node(void **n, int level) {
+    if (level > 1)
+        for (int k = 0; k < 1 << RADIX_BITS; k++)
+            if (n[k]) radix_free_node(n[k], level - 1);
+    free(n);
+}
+
+size_t radix_bytes(RadixPT *t) { return t->nodes * (1 << RADIX_BITS) * sizeof(uint64_t); }
+void radix_free(RadixPT *t) { radix_free_node(t->root, RADIX_LEVELS); }
+
 int simulate_fifo(int frames) {
     int i, faults = 0, next = 0;
 
     int *frame = malloc(frames * sizeof(int));
-    int *in_frame = malloc(PAGE_RANGE * sizeof(int));
+    InvertedPT ipt;
+    ipt_init(&ipt, frames);
 
-    for (i = 0; i < PAGE_RANGE; i++) in_frame[i] = 0;
     for (i = 0; i < frames; i++) frame[i] = -1;
 
     for (i = 0; i < REF_LEN; i++) {
         int p = rand_ref[i];
-        if (!in_frame[p]) {
+        if (ipt_lookup(&ipt, 0, p) == NO_FRAME) {
             faults++;
-            if (frame[next] != -1) in_frame[frame[next]] = 0;
+            if (frame[next] != -1) ipt_unmap(&ipt, next);
             frame[next] = p;
-            in_frame[p] = 1;
+            ipt_map(&ipt, next, 0, p);
             next = (next + 1) % frames;
         }
     }
 
     free(frame);
-    free(in_frame);
+    ipt_free(&ipt);
     return faults;
 }
 
@@ -80,7 +236,85 @@ int simulate_lru(int frames) {
     return faults;
 }
 
-int main() {
+static uint64_t rng_state = 88172645463325252ULL;
+static uint64_t xorshift64(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Maps `pages` pages of one sparse 48-bit address space (runs of `cluster` pages at random
+   places) into each table, then times random hit and miss lookups. */
+int page_table_benchmark(size_t pages, size_t cluster) {
+    const size_t lookups = 4000000;
+    uint64_t *vpn = malloc(pages * sizeof(uint64_t));
+    for (size_t i = 0; i < pages; i += cluster) {
+        uint64_t base = (xorshift64() & ((1ULL << VPN_BITS) - 1)) & ~(uint64_t)(cluster - 1);
+        for (size_t k = 0; k < cluster && i + k < pages; k++) vpn[i + k] = base + k;
+    }
+
+    RadixPT radix; HashedPT hpt; InvertedPT ipt;
+    radix_init(&radix);
+    hpt_init(&hpt, pages);
+    ipt_init(&ipt, pages);
+    for (size_t i = 0; i < pages; i++) {
+        radix_map(&radix, vpn[i], (uint32_t)i);
+        hpt_map(&hpt, 1, vpn[i], (uint32_t)i);
+        if (ipt_lookup(&ipt, 1, vpn[i]) == NO_FRAME) ipt_map(&ipt, (uint32_t)i, 1, vpn[i]);
+    }
+
+    uint64_t *hit = malloc(lookups * sizeof(uint64_t));
+    uint64_t *miss = malloc(lookups * sizeof(uint64_t));
+    for (size_t i = 0; i < lookups; i++) {
+        hit[i] = vpn[xorshift64() % pages];
+        miss[i] = xorshift64() & ((1ULL << VPN_BITS) - 1);
+    }
+
+    printf("%zu mapped pages in runs of %zu, %zu lookups each\n\n", pages, cluster, lookups);
+    printf("Table        | Memory (KB) | Bytes/page | Hit ns | Miss ns\n");
+    printf("-------------+-------------+------------+--------+--------\n");
+
+    const char *names[3] = {"4-level", "hashed", "inverted"};
+    size_t bytes[3] = {radix_bytes(&radix), hpt_bytes(&hpt), ipt_bytes(&ipt)};
+    uint64_t check = 0;
+    for (int kind = 0; kind < 3; kind++) {
+        double ns[2];
+        for (int pass = 0; pass < 2; pass++) {
+            uint64_t *keys = pass ? miss : hit;
+            double t0 = now_ns();
+            for (size_t i = 0; i < lookups; i++) {
+                if (kind == 0) check += radix_lookup(&radix, keys[i]);
+                else if (kind == 1) check += hpt_lookup(&hpt, 1, keys[i]);
+                else check += ipt_lookup(&ipt, 1, keys[i]);
+            }
+            ns[pass] = (now_ns() - t0) / lookups;
+        }
+        printf(" %-11s | %11zu | %10.2f | %6.1f | %6.1f\n", names[kind], bytes[kind] / 1024,
+               (double)bytes[kind] / pages, ns[0], ns[1]);
+    }
+    printf("\n(checksum %llu)\n", (unsigned long long)check);
+
+    radix_free(&radix); hpt_free(&hpt); ipt_free(&ipt);
+    free(vpn); free(hit); free(miss);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "pt") == 0) {
+        size_t pages = argc >= 3 ? strtoull(argv[2], NULL, 10) : 1000000;
+        size_t cluster = argc >= 4 ? strtoull(argv[3], NULL, 10) : 16;
+        if (pages < 1) pages = 1;
+        if (cluster < 1) cluster = 1;
+        return page_table_benchmark(pages, pow2_at_least(cluster));
+    }
+
     srand(time(NULL));
     for (int i = 0; i < REF_LEN; i++) rand_ref[i] = rand() % PAGE_RANGE;
     printf("Reference string:\n");
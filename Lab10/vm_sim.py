@@ -2,30 +2,327 @@ import threading
 import queue
 import time
 import random
+import os
+import sys
+import tempfile
+from collections import OrderedDict, deque
+from concurrent.futures import ThreadPoolExecutor
 
 NUM_PROCESSES = 3
 REF_LEN = 15
 PAGE_RANGE = 8
 NUM_FRAMES = 4
+WRITE_RATIO = 0.3         # fraction of references that are writes
+
+# fork() plan: parent pid -> number of references issued before it forks a child.
+# Children get pids NUM_PROCESSES, NUM_PROCESSES + 1, ... and share the parent's
+# frames copy-on-write.
+FORKS = {0: 5}
+TOTAL_PROCESSES = NUM_PROCESSES + len(FORKS)
+# After a fork the parent's next reference and the child's first one write the page the
+# parent referenced last, so the demo always takes the copy-on-write faults: the first
+# writer copies the shared frame and the second, now its last sharer, reuses it in place.
+FORK_WRITES = True
+
+# Replacement policy: "global" LRU over all frames, "local" LRU within an equal per-process
+# quota, "ws" working-set trimming with load control, or "pff" page-fault-frequency quotas.
+# Can be overridden on the command line: python3 vm_sim.py ws
+REPLACEMENT = "global"
+POLICIES = ("global", "local", "ws", "pff")
+TAU = 6                   # working-set window, in references of the owning process
+PFF_LOW = 3               # fault interval (refs) below which a process gets another frame
+PFF_HIGH = 8              # fault interval above which pages unused since the last fault go
+FAULT_COST = 100          # simulated ticks per page fault (a reference costs 1)
+
+# TLB model (set-associative, LRU within a set)
+TLB_ENTRIES = 4
+TLB_WAYS = 2
+TLB_USE_ASID = True       # False: flush the whole TLB on every context switch
+HUGE_PAGE_PAGES = 2       # base pages covered by one huge-page entry
+HUGE_PAGE_PROCS = {2}     # processes whose fully resident regions get huge entries
+
+# Swap backing store
+PAGE_SIZE = 4096
+IO_THREADS = 2
+WRITEBACK_BATCH = 4       # dirty victims collected before one batched pwritev pass
+READAHEAD = 2             # neighbouring swapped pages read in the same preadv as a fault
+SWAP_CACHE_PAGES = 8      # read-ahead pages kept until they are faulted in
 
 request_queue = queue.Queue()
 ready_queue = queue.Queue()
 terminate_event = threading.Event()
 
-page_tables = {pid: {} for pid in range(NUM_PROCESSES)}
-frame_to_owner = {}
+page_tables = {pid: {} for pid in range(TOTAL_PROCESSES)}
+frame_to_owner = {}       # frame -> set of (proc, page) mapping it; len() is the refcount
+cow_pages = {pid: set() for pid in range(TOTAL_PROCESSES)}
+cow_stats = {"shared": 0, "swap_shared": 0, "cow_faults": 0, "copied": 0, "reused": 0}
+proc_threads = []
 frame_lock = threading.Lock()
 lru_list = []
+memory = bytearray(NUM_FRAMES * PAGE_SIZE)
+page_stamp = {}           # (proc, page) -> last value written, checked on every page-in
+write_counter = 0
 
 def log(s):
     print(s)
 
-def process_thread(proc_id):
-    refs = [random.randint(0, PAGE_RANGE - 1) for _ in range(REF_LEN)]
-    log(f"Process {proc_id} created, refs: {refs}")
-    for page in refs:
+class TLB:
+    """Set-associative TLB. Each set is a list ordered LRU first, MRU last.
+    Entries are (asid, tag, huge); a huge entry's tag is page // HUGE_PAGE_PAGES."""
+
+    def __init__(self, entries, ways, use_asid):
+        self.ways = ways
+        self.num_sets = max(1, entries // ways)
+        self.sets = [[] for _ in range(self.num_sets)]
+        self.use_asid = use_asid
+        self.cur_asid = None
+        self.switches = 0
+        self.flushes = 0
+
+    def _set(self, tag):
+        return self.sets[tag % self.num_sets]
+
+    def switch_to(self, asid):
+        if asid == self.cur_asid:
+            return
+        if self.cur_asid is not None:
+            self.switches += 1
+            if not self.use_asid:
+                self.flush()
+        self.cur_asid = asid
+
+    def flush(self):
+        for s in self.sets:
+            s.clear()
+        self.flushes += 1
+
+    def lookup(self, asid, page):
+        for huge in (False, True):
+            tag = page // HUGE_PAGE_PAGES if huge else page
+            s = self._set(tag)
+            for i, e in enumerate(s):
+                if e == (asid, tag, huge):
+                    s.append(s.pop(i))
+                    return True
+        return False
+
+    def fill(self, asid, page, huge):
+        tag = page // HUGE_PAGE_PAGES if huge else page
+        s = self._set(tag)
+        if (asid, tag, huge) in s:
+            return
+        if len(s) >= self.ways:
+            s.pop(0)
+        s.append((asid, tag, huge))
+
+    def invalidate(self, asid, page):
+        # shootdown: drop the base entry and any huge entry covering the page
+        for huge in (False, True):
+            tag = page // HUGE_PAGE_PAGES if huge else page
+            s = self._set(tag)
+            if (asid, tag, huge) in s:
+                s.remove((asid, tag, huge))
+
+    def invalidate_asid(self, asid):
+        for s in self.sets:
+            s[:] = [e for e in s if e[0] != asid]
+
+tlb = TLB(TLB_ENTRIES, TLB_WAYS, TLB_USE_ASID)
+tlb_stats = {pid: {"hits": 0, "misses": 0, "walks": 0} for pid in range(TOTAL_PROCESSES)}
+
+class SwapDevice:
+    """Swap file with one slot per (process, page). A process's neighbouring pages sit in
+    neighbouring slots, so write-back batches and readahead clusters become single
+    pwritev/preadv calls, issued on a small I/O thread pool."""
+
+    def __init__(self):
+        self.fd, self.path = tempfile.mkstemp(prefix="vm_sim_swap_")
+        os.ftruncate(self.fd, TOTAL_PROCESSES * PAGE_RANGE * PAGE_SIZE)
+        self.pool = ThreadPoolExecutor(max_workers=IO_THREADS)
+        self.lock = threading.Lock()
+        self.valid = set()          # slots whose swap copy matches the page
+        self.dirty = {}             # slot -> data waiting for the next write-back batch
+        self.writing = {}           # slot -> data of a pwritev still in flight
+        self.write_futs = {}        # slot -> future of that pwritev
+        self.cache = OrderedDict()  # slot -> data read ahead but not yet mapped
+        self.alias = {}             # slot -> slot whose swap copy it shares since a fork
+        self.sharers = {}           # slot -> slots aliasing it (reference count of the copy)
+        self.stats = {"bytes_in": 0, "bytes_out": 0, "preadv": 0, "pwritev": 0}
+
+    @staticmethod
+    def slot(proc, page):
+        return proc * PAGE_RANGE + page
+
+    @staticmethod
+    def runs(slots):
+        run = []
+        for s in sorted(slots):
+            if run and s != run[-1] + 1:
+                yield run
+                run = []
+            run.append(s)
+        if run:
+            yield run
+
+    def share(self, parent, child, page):
+        """At fork: the child's slot refers to the parent's swap copy of a non-resident page
+        until either side writes the page. Returns False if the parent has no swap copy."""
+        s = self.slot(parent, page)
+        if s not in self.valid:
+            return False
+        src = self.alias.get(s, s)
+        c = self.slot(child, page)
+        self.alias[c] = src
+        self.sharers.setdefault(src, set()).add(c)
+        self.valid.add(c)
+        return True
+
+    def _unshare(self, s):
+        src = self.alias.pop(s, None)
+        if src is not None:
+            self.sharers[src].discard(s)
+            if not self.sharers[src]:
+                del self.sharers[src]
+
+    def _data(self, s):
+        """Current swap copy of slot s, from memory if a write or readahead holds it."""
+        with self.lock:
+            data = self.dirty.get(s)
+            if data is None:
+                data = self.writing.get(s)
+            if data is None:
+                data = self.cache.get(s)
+        if data is not None:
+            return data
+        return bytes(self.pool.submit(self._read, [s]).result()[0])
+
+    def _break_sharing(self, s):
+        """Slot s is about to be overwritten: every slot aliasing it gets its own copy."""
+        sharers = self.sharers.pop(s, None)
+        if not sharers:
+            return
+        data = self._data(s)
+        with self.lock:
+            for c in sharers:
+                del self.alias[c]
+                self.dirty[c] = data
+
+    def page_out(self, proc, page, data):
+        s = self.slot(proc, page)
+        if s in self.valid:
+            return  # clean page, the swap copy is still current
+        self._break_sharing(s)
+        self.valid.add(s)
+        with self.lock:
+            self.dirty[s] = data
+        if len(self.dirty) >= WRITEBACK_BATCH:
+            self.flush()
+
+    def invalidate(self, proc, page):
+        s = self.slot(proc, page)
+        self.valid.discard(s)
+        self._unshare(s)  # a slot others alias keeps its data until the next page_out
+
+    def flush(self):
+        with self.lock:
+            batch, self.dirty = self.dirty, {}
+            older = [self.write_futs[s] for s in batch if s in self.write_futs]
+        for fut in older:
+            fut.result()  # keep writes to one slot ordered
+        with self.lock:
+            self.writing.update(batch)
+        for run in self.runs(batch):
+            bufs = [batch[s] for s in run]
+            with self.lock:  # _write needs the lock, so it cannot finish before this
+                fut = self.pool.submit(self._write, run, bufs)
+                for s in run:
+                    self.write_futs[s] = fut
+
+    def _write(self, run, bufs):
+        n = os.pwritev(self.fd, bufs, run[0] * PAGE_SIZE)
+        with self.lock:
+            for s, b in zip(run, bufs):
+                if self.writing.get(s) is b:
+                    del self.writing[s]
+                    del self.write_futs[s]
+            self.stats["pwritev"] += 1
+            self.stats["bytes_out"] += n
+
+    def _read(self, run):
+        bufs = [bytearray(PAGE_SIZE) for _ in run]
+        n = os.preadv(self.fd, bufs, run[0] * PAGE_SIZE)
+        with self.lock:
+            self.stats["preadv"] += 1
+            self.stats["bytes_in"] += n
+        return bufs
+
+    def page_in(self, proc, page):
+        """Returns (data, kind); data is None for a page that was never swapped out."""
+        s = self.slot(proc, page)
+        if s not in self.valid:
+            return None, "zero-fill"
+        if s in self.alias:
+            return self._data(self.alias[s]), "major"
+        with self.lock:
+            data = self.dirty.get(s)
+            if data is None:
+                data = self.writing.get(s)
+            if data is None:
+                data = self.cache.pop(s, None)
+            if data is not None:
+                return data, "swap cache"
+            # cluster: the faulting page plus following swapped-out, non-resident pages
+            run = [s]
+            for p in range(page + 1, min(page + 1 + READAHEAD, PAGE_RANGE)):
+                n = self.slot(proc, p)
+                if (n not in self.valid or p in page_tables[proc] or n in self.dirty
+                        or n in self.writing or n in self.cache or n in self.alias):
+                    break
+                run.append(n)
+        bufs = self.pool.submit(self._read, run).result()
+        with self.lock:
+            for n, b in zip(run[1:], bufs[1:]):
+                self.cache[n] = bytes(b)
+            while len(self.cache) > SWAP_CACHE_PAGES:
+                self.cache.popitem(last=False)
+        return bytes(bufs[0]), "major"
+
+    def close(self):
+        self.flush()
+        self.pool.shutdown(wait=True)
+        os.close(self.fd)
+        os.unlink(self.path)
+
+swap = SwapDevice()
+fault_latency = []        # (seconds, kind) per page fault
+
+def region_resident(proc, page):
+    base = page - page % HUGE_PAGE_PAGES
+    return all(p in page_tables[proc] for p in range(base, base + HUGE_PAGE_PAGES))
+
+def tlb_fill(proc, page):
+    huge = proc in HUGE_PAGE_PROCS and region_resident(proc, page)
+    tlb.fill(proc, page, huge)
+
+def process_thread(proc_id, inherited=None):
+    refs = [(random.randint(0, PAGE_RANGE - 1), random.random() < WRITE_RATIO)
+            for _ in range(REF_LEN)]
+    at = FORKS.get(proc_id)
+    if FORK_WRITES and at is not None and 0 < at < REF_LEN:
+        refs[at] = (refs[at - 1][0], True)
+    if FORK_WRITES and inherited is not None:
+        refs[0] = (inherited, True)
+    shown = [f"{p}{'w' if w else 'r'}" for p, w in refs]
+    log(f"Process {proc_id} created, refs: {shown}")
+    for n, (page, write) in enumerate(refs):
+        if FORKS.get(proc_id) == n:
+            child = NUM_PROCESSES + list(FORKS).index(proc_id)
+            request_queue.put(("FORK", proc_id, child))
+            t = threading.Thread(target=process_thread, args=(child, refs[n - 1][0] if n else None))
+            proc_threads.append(t)
+            t.start()
         ready_queue.put(proc_id)
-        request_queue.put((proc_id, page))
+        request_queue.put((proc_id, page, write))
         time.sleep(0.05 + random.random() * 0.05)
     log(f"Process {proc_id} finished.")
     request_queue.put(("DONE", proc_id))
@@ -40,34 +337,217 @@ def mmu_thread():
     log("MMU started.")
     free_frames = list(range(NUM_FRAMES))
     page_faults = 0
+    done = 0
+    vtime = {pid: 0 for pid in range(TOTAL_PROCESSES)}
+    history = {pid: deque(maxlen=TAU) for pid in range(TOTAL_PROCESSES)}
+    last_use = {}
+    last_fault = {pid: 0 for pid in range(TOTAL_PROCESSES)}
+    quota = {pid: max(1, NUM_FRAMES // TOTAL_PROCESSES) for pid in range(TOTAL_PROCESSES)}
+    started = set(range(NUM_PROCESSES))   # forked children join at their FORK event
+    suspended = set()
+    finished = set()
+    deferred = {pid: [] for pid in range(TOTAL_PROCESSES)}
+    load_stats = {"refs": 0, "ticks": 0, "suspends": 0, "resumes": 0, "trimmed": 0}
 
-    def load_page(proc, page):
-        nonlocal page_faults
-        page_faults += 1
-        if free_frames:
+    def choose_victim(proc):
+        lru_list.sort(key=lambda x: x[0])
+        if REPLACEMENT in ("local", "pff") and len(page_tables[proc]) >= quota[proc]:
+            for i, (t, f) in enumerate(lru_list):
+                if any(o[0] == proc for o in frame_to_owner[f]):
+                    return lru_list.pop(i)[1]
+        return lru_list.pop(0)[1]
+
+    def get_frame(proc, page):
+        local_full = REPLACEMENT in ("local", "pff") and len(page_tables[proc]) >= quota[proc]
+        if free_frames and not (local_full and page_tables[proc]):
             f = free_frames.pop(0)
             log(f"Page Fault handled for Process {proc}, Page {page} -> Frame {f}")
-        else:
-            lru_list.sort(key=lambda x: x[0])
-            victim_frame = lru_list.pop(0)[1]
-            vproc, vpage = frame_to_owner.pop(victim_frame)
+            return f
+        f = choose_victim(proc)
+        data = bytes(memory[f * PAGE_SIZE:(f + 1) * PAGE_SIZE])
+        # unmap every sharer of the victim frame (reverse mapping)
+        for vproc, vpage in frame_to_owner.pop(f):
+            swap.page_out(vproc, vpage, data)
             if vpage in page_tables[vproc]:
                 del page_tables[vproc][vpage]
-            f = victim_frame
+            cow_pages[vproc].discard(vpage)
+            tlb.invalidate(vproc, vpage)
             log(f"Replaced Frame {f} of Process {vproc} Page {vpage} with Process {proc} Page {page}")
+        return f
+
+    def unmap(proc, page):
+        f = page_tables[proc].pop(page)
+        swap.page_out(proc, page, bytes(memory[f * PAGE_SIZE:(f + 1) * PAGE_SIZE]))
+        cow_pages[proc].discard(page)
+        tlb.invalidate(proc, page)
+        owners = frame_to_owner[f]
+        owners.discard((proc, page))
+        if not owners:
+            del frame_to_owner[f]
+            lru_list[:] = [e for e in lru_list if e[1] != f]
+            free_frames.append(f)
+
+    def ws_size(proc):
+        return len(set(history[proc]))
+
+    def active(p):
+        return p in started and p not in suspended and p not in finished
+
+    def demand():
+        need = ws_size if REPLACEMENT == "ws" else (lambda p: quota[p])
+        return sum(need(p) for p in range(TOTAL_PROCESSES) if active(p))
+
+    def suspend_one(proc):
+        """Load control: swap out the lowest-priority (highest pid) other active process.
+        Returns False if there is none."""
+        candidates = [p for p in range(TOTAL_PROCESSES) if p != proc and active(p)]
+        if not candidates:
+            return False
+        v = candidates[-1]
+        suspended.add(v)
+        for page in list(page_tables[v]):
+            unmap(v, page)
+        load_stats["suspends"] += 1
+        log(f"Load control: demand {demand() + (ws_size(v) if REPLACEMENT == 'ws' else quota[v])} "
+            f"> {NUM_FRAMES} frames, suspending Process {v}")
+        return True
+
+    def try_resume():
+        for p in sorted(suspended):
+            need = ws_size(p) if REPLACEMENT == "ws" else quota[p]
+            idle = not any(active(q) for q in range(TOTAL_PROCESSES))
+            if idle or demand() + need <= NUM_FRAMES:
+                suspended.discard(p)
+                load_stats["resumes"] += 1
+                log(f"Load control: resuming Process {p}")
+                while deferred[p] and p not in suspended:
+                    handle(deferred[p].pop(0))
+
+    def pff_fault(proc):
+        interval = vtime[proc] - last_fault[proc]
+        prev = last_fault[proc]
+        last_fault[proc] = vtime[proc]
+        if interval < PFF_LOW:
+            quota[proc] += 1
+            while demand() > NUM_FRAMES and suspend_one(proc):
+                pass
+        elif interval > PFF_HIGH:
+            for page in [p for p in page_tables[proc] if last_use.get((proc, p), 0) < prev]:
+                unmap(proc, page)
+                load_stats["trimmed"] += 1
+            quota[proc] = len(page_tables[proc]) + 1
+
+    def ws_trim(proc):
+        for page in [p for p in page_tables[proc] if vtime[proc] - last_use.get((proc, p), 0) >= TAU]:
+            unmap(proc, page)
+            load_stats["trimmed"] += 1
+        if demand() > NUM_FRAMES:
+            suspend_one(proc)
+
+    def map_page(proc, page, f, data):
+        memory[f * PAGE_SIZE:(f + 1) * PAGE_SIZE] = data if data is not None else bytes(PAGE_SIZE)
         page_tables[proc][page] = f
-        frame_to_owner[f] = (proc, page)
+        frame_to_owner[f] = {(proc, page)}
         now = time.time()
         lru_list.append((now, f))
 
-    while True:
-        item = request_queue.get()
+    def load_page(proc, page):
+        nonlocal page_faults
+        page_faults += 1
+        load_stats["ticks"] += FAULT_COST
+        if REPLACEMENT == "pff":
+            pff_fault(proc)
+        start = time.perf_counter()
+        f = get_frame(proc, page)
+        data, kind = swap.page_in(proc, page)
+        map_page(proc, page, f, data)
+        fault_latency.append((time.perf_counter() - start, kind))
+        got = int.from_bytes(memory[f * PAGE_SIZE:f * PAGE_SIZE + 8], "little")
+        if got != page_stamp.get((proc, page), 0):
+            log(f"ERROR: Process {proc} Page {page} paged in stale data ({got})")
+        log(f"Page in ({kind}): Process {proc} Page {page} -> Frame {f}")
+
+    def write_page(proc, page):
+        global write_counter
+        write_counter += 1
+        f = page_tables[proc][page]
+        memory[f * PAGE_SIZE:f * PAGE_SIZE + 8] = write_counter.to_bytes(8, "little")
+        page_stamp[(proc, page)] = write_counter
+        swap.invalidate(proc, page)
+
+    def fork(parent, child):
+        page_tables[child] = dict(page_tables[parent])
+        for page, f in page_tables[parent].items():
+            frame_to_owner[f].add((child, page))
+            page_stamp[(child, page)] = page_stamp.get((parent, page), 0)
+            cow_pages[parent].add(page)
+            cow_pages[child].add(page)
+        # swapped-out pages: the child shares the parent's swap copies
+        swapped = [p for p in range(PAGE_RANGE)
+                   if p not in page_tables[parent] and swap.share(parent, child, p)]
+        for page in swapped:
+            page_stamp[(child, page)] = page_stamp.get((parent, page), 0)
+        cow_stats["shared"] += len(page_tables[parent])
+        cow_stats["swap_shared"] += len(swapped)
+        # parent mappings became read-only, drop its cached translations
+        tlb.invalidate_asid(parent)
+        log(f"Process {parent} forked Process {child}, sharing {len(page_tables[parent])} pages copy-on-write"
+            f" and {len(swapped)} swapped-out pages")
+
+    def cow_fault(proc, page):
+        cow_stats["cow_faults"] += 1
+        f = page_tables[proc][page]
+        cow_pages[proc].discard(page)
+        if len(frame_to_owner[f]) == 1:
+            cow_stats["reused"] += 1
+            log(f"COW fault: Process {proc} Page {page} is the last sharer of Frame {f}, reused in place")
+            return
+        frame_to_owner[f].discard((proc, page))
+        del page_tables[proc][page]
+        data = bytes(memory[f * PAGE_SIZE:(f + 1) * PAGE_SIZE])
+        nf = get_frame(proc, page)
+        map_page(proc, page, nf, data)
+        tlb.invalidate(proc, page)
+        cow_stats["copied"] += 1
+        log(f"COW fault: Process {proc} Page {page} copied from Frame {f} to Frame {nf}")
+
+    def handle(item):
+        nonlocal done
+        owner = item[1] if item[0] in ("DONE", "FORK") else item[0]
+        if owner in suspended or owner not in started:  # a child cannot run before its fork
+            deferred[owner].append(item)
+            return
         if item[0] == "DONE":
             pid_done = item[1]
             log(f"Process {pid_done} completed.")
-            continue
-        proc, page = item
-        log(f"Process {proc} requests page {page}")
+            finished.add(pid_done)
+            done += 1
+            return
+        if item[0] == "FORK":
+            child = item[2]
+            with frame_lock:
+                fork(item[1], child)
+            started.add(child)
+            if deferred[child]:
+                log(f"Process {child} starts with {len(deferred[child])} requests queued before its fork")
+            while deferred[child] and child not in suspended:
+                handle(deferred[child].pop(0))
+            return
+        access(*item)
+
+    def access(proc, page, write):
+        vtime[proc] += 1
+        history[proc].append(page)
+        last_use[(proc, page)] = vtime[proc]
+        load_stats["refs"] += 1
+        load_stats["ticks"] += 1
+        log(f"Process {proc} {'writes' if write else 'reads'} page {page}")
+        tlb.switch_to(proc)
+        if tlb.lookup(proc, page):
+            tlb_stats[proc]["hits"] += 1
+        else:
+            tlb_stats[proc]["misses"] += 1
+            tlb_stats[proc]["walks"] += 1
         if page in page_tables[proc]:
             frame = page_tables[proc][page]
             now = time.time()
@@ -77,13 +557,71 @@ def mmu_thread():
                     break
             lru_list.append((now, frame))
             log(f"Page hit: Process {proc} Page {page} in Frame {frame}")
+            if write and page in cow_pages[proc]:
+                with frame_lock:
+                    cow_fault(proc, page)
         else:
             log(f"Page fault: Process {proc} Page {page}")
-            time.sleep(0.1)
             with frame_lock:
                 load_page(proc, page)
+            tlb_stats[proc]["walks"] += 1  # the faulting access is retried
+        if write:
+            write_page(proc, page)
+        tlb_fill(proc, page)
+        if REPLACEMENT == "ws":
+            with frame_lock:
+                ws_trim(proc)
         time.sleep(0.01)
 
+    while done < TOTAL_PROCESSES:
+        handle(request_queue.get())
+        try_resume()
+
+    swap.close()
+    report(page_faults)
+    log(f"Replacement: {REPLACEMENT}, {load_stats['refs']} references in {load_stats['ticks']} ticks "
+        f"-> throughput {1000 * load_stats['refs'] / max(1, load_stats['ticks']):.1f} refs per 1000 ticks")
+    log(f"Load control: {load_stats['suspends']} suspensions, {load_stats['resumes']} resumptions, "
+        f"{load_stats['trimmed']} pages trimmed from working sets")
+
+def report(page_faults):
+    mode = "ASID-tagged" if TLB_USE_ASID else "flush-on-switch"
+    log(f"\nTLB: {TLB_ENTRIES} entries, {TLB_WAYS}-way, {mode}, "
+        f"{tlb.switches} context switches, {tlb.flushes} flushes")
+    log("Process | TLB hits | TLB misses | Hit rate | Page walks")
+    for pid in range(TOTAL_PROCESSES):
+        s = tlb_stats[pid]
+        refs = s["hits"] + s["misses"]
+        rate = s["hits"] / refs if refs else 0.0
+        log(f"  {pid:3d}   | {s['hits']:8d} | {s['misses']:10d} | {rate:8.2%} | {s['walks']:10d}")
+    log(f"Total page faults: {page_faults}")
+    still_shared = sum(len(o) - 1 for o in frame_to_owner.values())
+    log(f"COW: {cow_stats['shared']} pages shared at fork ({cow_stats['swap_shared']} more in swap), "
+        f"{cow_stats['cow_faults']} write faults, "
+        f"{cow_stats['copied']} copied, {cow_stats['reused']} reused in place")
+    log(f"COW: {cow_stats['shared'] - cow_stats['copied']} copies avoided, "
+        f"{still_shared} frames still saved by sharing at exit")
+    # every mapping is counted in its frame's owner set and every owner maps that frame
+    bad = [(p, pg) for p in page_tables for pg, f in page_tables[p].items()
+           if (p, pg) not in frame_to_owner.get(f, ())]
+    bad += [o for f, owners in frame_to_owner.items() for o in owners
+            if page_tables[o[0]].get(o[1]) != f]
+    if bad or cow_stats["cow_faults"] != cow_stats["copied"] + cow_stats["reused"]:
+        log(f"ERROR: COW refcounts inconsistent: {bad[:4]}, "
+            f"{cow_stats['cow_faults']} faults vs {cow_stats['copied']} + {cow_stats['reused']}")
+    lat = sorted(t for t, _ in fault_latency)
+    if lat:
+        pct = lambda q: lat[min(len(lat) - 1, int(q * len(lat)))] * 1e6
+        kinds = {}
+        for _, k in fault_latency:
+            kinds[k] = kinds.get(k, 0) + 1
+        log(f"Fault service latency (us): p50 {pct(0.50):.1f}, p90 {pct(0.90):.1f}, "
+            f"p99 {pct(0.99):.1f}, max {lat[-1] * 1e6:.1f}")
+        log("Faults by kind: " + ", ".join(f"{k} {n}" for k, n in sorted(kinds.items())))
+    st = swap.stats
+    log(f"Swap: {st['bytes_in']} bytes in over {st['preadv']} preadv, "
+        f"{st['bytes_out']} bytes out over {st['pwritev']} pwritev")
+
 def master_thread():
     log("Master started.")
     sched = threading.Thread(target=scheduler_thread, daemon=True)
@@ -98,10 +636,18 @@ def master_thread():
         time.sleep(0.02)
     for t in procs:
         t.join()
+    mmu.join()
+    for t in proc_threads:
+        t.join()
     terminate_event.set()
     log("Master terminating. All processes completed.")
     time.sleep(0.2)
 
 if __name__ == "__main__":
+    if len(sys.argv) > 2 or (len(sys.argv) == 2 and sys.argv[1] not in POLICIES):
+        print(f"Usage: {sys.argv[0]} [{'|'.join(POLICIES)}]", file=sys.stderr)
+        sys.exit(1)
+    if len(sys.argv) > 1:
+        REPLACEMENT = sys.argv[1]
     random.seed(42)
-    master_thread()
\ No newline at end of file
+    master_thread()